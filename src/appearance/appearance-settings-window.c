@@ -18,6 +18,7 @@
 
 #include "settings-config.h"
 #include "appearance-settings-window.h"
+#include "settings-keys.h"
 
 struct _AppearanceSettingsWindow
 {
@@ -37,11 +38,30 @@ struct _AppearanceSettingsWindow
 
 G_DEFINE_TYPE(AppearanceSettingsWindow, appearance_settings_window, ADW_TYPE_NAVIGATION_PAGE)
 
+static void
+appearance_settings_window_dispose(GObject *object)
+{
+  AppearanceSettingsWindow *self = APPEARANCE_SETTINGS_WINDOW(object);
+
+  /* The page can be destroyed when it has been hidden for a while */
+  if (self->bg_settings)
+    g_signal_handlers_disconnect_by_data(self->bg_settings, self);
+
+  g_clear_object(&self->bg_settings);
+  g_clear_object(&self->interface_settings);
+  g_clear_object(&self->file_dialog);
+
+  G_OBJECT_CLASS(appearance_settings_window_parent_class)->dispose(object);
+}
+
 static void
 appearance_settings_window_class_init(AppearanceSettingsWindowClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
   GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
 
+  object_class->dispose = appearance_settings_window_dispose;
+
   gtk_widget_class_set_template_from_resource(widget_class, "/com/plenjos/Settings/appearance/appearance-settings-window.ui");
   gtk_widget_class_bind_template_child(widget_class, AppearanceSettingsWindow, appearance_settings_preferences_page);
   gtk_widget_class_bind_template_child(widget_class, AppearanceSettingsWindow, theme_combo_row);
@@ -82,18 +102,10 @@ static void on_theme_selected(AdwComboRow *row, gpointer *idk, AppearanceSetting
 {
   guint item = adw_combo_row_get_selected(row);
 
-  if (item == 1)
-  {
-    g_settings_set_string(self->interface_settings, "color-scheme", "prefer-light");
-  }
-  else if (item == 2)
-  {
-    g_settings_set_string(self->interface_settings, "color-scheme", "prefer-dark");
-  }
-  else
-  {
-    g_settings_set_string(self->interface_settings, "color-scheme", "default");
-  }
+  if (item >= g_strv_length((char **)settings_keys_color_schemes))
+    item = 0;
+
+  g_settings_set_string(self->interface_settings, "color-scheme", settings_keys_color_schemes[item]);
 }
 
 static void
@@ -113,25 +125,17 @@ static void appearance_settings_window_init(AppearanceSettingsWindow *self)
 
   self->file_dialog = gtk_file_dialog_new();
 
-  self->bg_settings = g_settings_new("com.plenjos.shell.desktop");
-  self->interface_settings = g_settings_new("org.gnome.desktop.interface");
+  self->bg_settings = g_settings_new(SETTINGS_KEYS_DESKTOP_SCHEMA);
+  self->interface_settings = g_settings_new(SETTINGS_KEYS_INTERFACE_SCHEMA);
 
   char *scheme = g_settings_get_string(self->interface_settings, "color-scheme");
 
-  if (!strcmp(scheme, "prefer-dark"))
-  {
-    adw_combo_row_set_selected(self->theme_combo_row, 2);
-  }
-  else
+  adw_combo_row_set_selected(self->theme_combo_row, 0);
+
+  for (guint i = 0; settings_keys_color_schemes[i]; i++)
   {
-    if (!strcmp(scheme, "prefer-light"))
-    {
-      adw_combo_row_set_selected(self->theme_combo_row, 1);
-    }
-    else
-    {
-      adw_combo_row_set_selected(self->theme_combo_row, 0);
-    }
+    if (!strcmp(scheme, settings_keys_color_schemes[i]))
+      adw_combo_row_set_selected(self->theme_combo_row, i);
   }
 
   if (scheme)
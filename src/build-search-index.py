@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+#
+# build-search-index.py
+#
+# Copyright 2023 Benjamin Montgomery
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+"""Builds the settings search index from the panels' UI files.
+
+Every row with a title becomes an entry. Its search text is the row title,
+the title of its group and any combo row choices. Rows that are only
+created in code are listed in a separate keywords file.
+
+The output is read in place by settings-search.c. All integers are
+little-endian u32:
+
+    "PSI1"
+    n_entries, n_words, n_trigrams, n_postings
+    entries   n_entries  x (panel, row id, title, text)   string offsets
+    words     n_words    x (word, entry)                  sorted by word
+    trigrams  n_trigrams x (trigram, first posting, count) sorted by trigram
+    postings  n_postings x entry
+    string pool, NUL-terminated
+
+Search text is lowercased (ASCII only, to match g_ascii_strdown()).
+"""
+
+import argparse
+import struct
+import sys
+import xml.etree.ElementTree as ET
+
+MAGIC = b"PSI1"
+
+
+def ascii_lower(text):
+    return "".join(c.lower() if c.isascii() else c for c in text)
+
+
+def get_property(obj, name):
+    for prop in obj.findall("property"):
+        if prop.get("name") == name and prop.text:
+            return prop.text.strip()
+    return None
+
+
+def string_list_items(obj):
+    items = []
+    for model in obj.findall("property[@name='model']/object"):
+        for item in model.findall("items/item"):
+            if item.text:
+                items.append(item.text.strip())
+    return items
+
+
+def walk(obj, panel, group, entries):
+    cls = obj.get("class", "")
+    title = get_property(obj, "title")
+
+    if cls == "AdwPreferencesGroup":
+        group = title
+
+    if title and cls.endswith("Row"):
+        words = [title]
+        if group:
+            words.append(group)
+        words.extend(string_list_items(obj))
+        entries.append((panel, obj.get("id") or "", title, " ".join(words)))
+
+    # Objects nested through <child> or <property>
+    for holder in obj:
+        if holder.tag in ("child", "property"):
+            for child in holder:
+                if child.tag == "object":
+                    walk(child, panel, group, entries)
+
+
+def read_ui(panel, path, entries):
+    root = ET.parse(path).getroot()
+    for obj in root:
+        if obj.tag in ("object", "template"):
+            walk(obj, panel, None, entries)
+
+
+def read_keywords(path, entries):
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if not line or line.startswith("#"):
+                continue
+            panel, row, title, keywords = (line.split("\t") + [""] * 4)[:4]
+            entries.append((panel, row, title, " ".join(filter(None, (title, keywords)))))
+
+
+def build(entries):
+    strings = bytearray()
+    offsets = {}
+
+    def intern(s):
+        if s not in offsets:
+            offsets[s] = len(strings)
+            strings.extend(s.encode("utf-8") + b"\0")
+        return offsets[s]
+
+    entry_table = []
+    words = set()
+    trigrams = {}
+
+    for index, (panel, row, title, text) in enumerate(entries):
+        text = ascii_lower(" ".join(text.split()))
+        entry_table.append((intern(panel), intern(row), intern(title), intern(text)))
+
+        for word in text.split():
+            words.add((word, index))
+
+        encoded = text.encode("utf-8")
+        for i in range(len(encoded) - 2):
+            key = (encoded[i] << 16) | (encoded[i + 1] << 8) | encoded[i + 2]
+            trigrams.setdefault(key, set()).add(index)
+
+    word_table = sorted(words, key=lambda w: (w[0].encode("utf-8"), w[1]))
+
+    trigram_table = []
+    postings = []
+    for key in sorted(trigrams):
+        members = sorted(trigrams[key])
+        trigram_table.append((key, len(postings), len(members)))
+        postings.extend(members)
+
+    out = bytearray(MAGIC)
+    out += struct.pack("<4I", len(entry_table), len(word_table), len(trigram_table), len(postings))
+    for entry in entry_table:
+        out += struct.pack("<4I", *entry)
+    for word, index in word_table:
+        out += struct.pack("<2I", intern(word), index)
+    for trigram in trigram_table:
+        out += struct.pack("<3I", *trigram)
+    for index in postings:
+        out += struct.pack("<I", index)
+    out += strings
+
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--output", required=True)
+    parser.add_argument("--keywords", action="append", default=[])
+    parser.add_argument("--panel", nargs=2, action="append", default=[],
+                        metavar=("ID", "UI_FILE"))
+    args = parser.parse_args()
+
+    entries = []
+    for panel, path in args.panel:
+        read_ui(panel, path, entries)
+    for path in args.keywords:
+        read_keywords(path, entries)
+
+    if not entries:
+        sys.exit("No searchable rows found")
+
+    with open(args.output, "wb") as f:
+        f.write(build(entries))
+
+
+if __name__ == "__main__":
+    main()
@@ -17,12 +17,38 @@
  */
 
 #include <glib/gi18n.h>
+#include <glib-unix.h>
+#include <signal.h>
 
 #include "settings-config.h"
 #include "settings-window.h"
+#include "settings-profiler.h"
+#include "network/network-settings-window.h"
+
+/* Set once the process has been asked to stay resident with --service */
+static gboolean service_mode = FALSE;
+
+static GtkWindow *
+get_window(GtkApplication *app)
+{
+	GtkWindow *window;
+
+	/* Get the current window or create one if necessary. */
+	window = gtk_application_get_active_window(app);
+	if (window == NULL)
+		window = g_object_new(SETTINGS_TYPE_WINDOW,
+							  "application", app,
+							  NULL);
+
+	/* A resident process keeps its window around so the next activation
+	 * only has to show it again. */
+	gtk_window_set_hide_on_close(window, service_mode);
+
+	return window;
+}
 
 static void
-on_activate(GtkApplication *app)
+present_window(GtkApplication *app, const char *panel, const char *device)
 {
 	GtkWindow *window;
 
@@ -32,12 +58,19 @@ on_activate(GtkApplication *app)
 	 */
 	g_assert(GTK_IS_APPLICATION(app));
 
-	/* Get the current window or create one if necessary. */
-	window = gtk_application_get_active_window(app);
-	if (window == NULL)
-		window = g_object_new(SETTINGS_TYPE_WINDOW,
-							  "application", app,
-							  NULL);
+	settings_profiler_begin("on_activate");
+
+	window = get_window(app);
+
+	/* A device's page lives on the Network panel */
+	if (device)
+		panel = "Network";
+
+	if (panel)
+		settings_window_show_panel(SETTINGS_WINDOW(window), panel);
+
+	if (device)
+		network_settings_window_show_device(NETWORK_SETTINGS_WINDOW(settings_window_get_panel(SETTINGS_WINDOW(window), panel)), device);
 
 	/* GdkPixbuf *icon_24 = gtk_icon_theme_load_icon (gtk_icon_theme_get_default (), "systemsettings", 24, 0, NULL);
 	GdkPixbuf *icon_32 = gtk_icon_theme_load_icon (gtk_icon_theme_get_default (), "systemsettings", 32, 0, NULL);
@@ -71,6 +104,83 @@ on_activate(GtkApplication *app)
 
 	/* Ask the window manager/compositor to present the window. */
 	gtk_window_present(window);
+
+	settings_profiler_end("on_activate");
+}
+
+static void
+on_activate(GtkApplication *app)
+{
+	present_window(app, NULL, NULL);
+}
+
+static void
+start_service(GtkApplication *app)
+{
+	if (service_mode)
+		return;
+
+	service_mode = TRUE;
+
+	/* Keep running with no windows open, and do the expensive setup now
+	 * so that later activations only have to present the window. */
+	g_application_hold(G_APPLICATION(app));
+
+	settings_window_prewarm(SETTINGS_WINDOW(get_window(app)));
+}
+
+static void
+on_open_panel(GSimpleAction *action, GVariant *parameter, GtkApplication *app)
+{
+	const char *panel = g_variant_get_string(parameter, NULL);
+
+	if (!settings_panels_lookup(panel))
+	{
+		g_warning("Unknown panel \"%s\"", panel);
+		panel = NULL;
+	}
+
+	present_window(app, panel, NULL);
+}
+
+static void
+on_open_device(GSimpleAction *action, GVariant *parameter, GtkApplication *app)
+{
+	present_window(app, NULL, g_variant_get_string(parameter, NULL));
+}
+
+static gboolean
+on_terminate(GApplication *app)
+{
+	g_application_quit(app);
+
+	return G_SOURCE_REMOVE;
+}
+
+static int
+on_command_line(GtkApplication *app, GApplicationCommandLine *cmdline)
+{
+	GVariantDict *options = g_application_command_line_get_options_dict(cmdline);
+	const char *panel = NULL;
+	const char *device = NULL;
+
+	if (g_variant_dict_contains(options, "service"))
+	{
+		start_service(app);
+		return 0;
+	}
+
+	if (g_variant_dict_lookup(options, "panel", "&s", &panel) && !settings_panels_lookup(panel))
+	{
+		g_application_command_line_printerr(cmdline, "Unknown panel \"%s\"\n", panel);
+		return 1;
+	}
+
+	g_variant_dict_lookup(options, "device", "&s", &device);
+
+	present_window(app, panel, device);
+
+	return 0;
 }
 
 int main(int argc,
@@ -79,6 +189,9 @@ int main(int argc,
 	g_autoptr(GtkApplication) app = NULL;
 	int ret;
 
+	/* Must come first so the "main" phase starts as early as possible */
+	settings_profiler_init(&argc, &argv);
+
 	/* Set up gettext translations */
 	bindtextdomain(GETTEXT_PACKAGE, LOCALEDIR);
 	bind_textdomain_codeset(GETTEXT_PACKAGE, "UTF-8");
@@ -89,7 +202,34 @@ int main(int argc,
 	 * application windows, integration with the window manager/compositor, and
 	 * desktop features such as file opening and single-instance applications.
 	 */
-	app = gtk_application_new("com.plenjos.Settings", G_APPLICATION_DEFAULT_FLAGS);
+	app = gtk_application_new("com.plenjos.Settings", G_APPLICATION_HANDLES_COMMAND_LINE);
+
+	/*
+	 * Command line options are parsed in whichever process runs first and
+	 * forwarded to it, so `plenjos-settings --panel=Network` opens the page
+	 * in an already running (or resident, see --service) instance.
+	 */
+	g_application_add_main_option(G_APPLICATION(app), "panel", 'p', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING,
+								  "Open the given panel", "PANEL");
+	g_application_add_main_option(G_APPLICATION(app), "device", 'd', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING,
+								  "Open the page of the given network interface", "IFACE");
+	g_application_add_main_option(G_APPLICATION(app), "service", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE,
+								  "Stay resident in the background so later launches are instant", NULL);
+
+	/*
+	 * The shell can also open a panel over D-Bus without spawning us, via
+	 * the org.gtk.Actions interface: app.open-panel('Network'), or
+	 * app.open-device('wlan0') for a network device's page.
+	 */
+	GSimpleAction *open_panel = g_simple_action_new("open-panel", G_VARIANT_TYPE_STRING);
+	g_signal_connect(open_panel, "activate", G_CALLBACK(on_open_panel), app);
+	g_action_map_add_action(G_ACTION_MAP(app), G_ACTION(open_panel));
+	g_object_unref(open_panel);
+
+	GSimpleAction *open_device = g_simple_action_new("open-device", G_VARIANT_TYPE_STRING);
+	g_signal_connect(open_device, "activate", G_CALLBACK(on_open_device), app);
+	g_action_map_add_action(G_ACTION_MAP(app), G_ACTION(open_device));
+	g_object_unref(open_device);
 
 	/*
 	 * We connect to the activate signal to create a window when the application
@@ -101,6 +241,12 @@ int main(int argc,
 	 * our "on_activate" function to a GCallback.
 	 */
 	g_signal_connect(app, "activate", G_CALLBACK(on_activate), NULL);
+	g_signal_connect(app, "command-line", G_CALLBACK(on_command_line), NULL);
+
+	/* Shut down properly when we are told to stop, so pages are disposed
+	 * and anything pending is written out (and the soak test's
+	 * LeakSanitizer gets its check at exit) */
+	g_unix_signal_add(SIGTERM, (GSourceFunc)on_terminate, app);
 
 	/*
 	 * Run the application. This function will block until the application
@@ -112,7 +258,12 @@ int main(int argc,
 	 * method "run". But we need to cast, which is what the "G_APPLICATION()"
 	 * macro does.
 	 */
+	settings_profiler_mark("g_application_run");
 	ret = g_application_run(G_APPLICATION(app), argc, argv);
 
+	/* Writes the profile if the window never got to draw a frame */
+	settings_profiler_finish();
+	settings_profiler_finish_samples();
+
 	return ret;
 }
@@ -0,0 +1,336 @@
+/* connection-timing.c
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "settings-config.h"
+#include "connection-timing.h"
+
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+
+/* Results kept per connection and stage */
+#define HISTORY_LENGTH 10
+
+typedef enum
+{
+  STAGE_PREPARE,
+  STAGE_CONFIG,
+  STAGE_NEED_AUTH,
+  STAGE_IP_CONFIG,
+  STAGE_IP_CHECK,
+  N_STAGES
+} Stage;
+
+/* Key names in the history file */
+static const char *stage_keys[N_STAGES] = {
+    "prepare",
+    "config",
+    "need-auth",
+    "ip-config",
+    "ip-check",
+};
+
+struct ConnectionTiming
+{
+  NMDevice *device;
+  char *uuid;
+  /* The activation being timed, once NetworkManager has said which */
+  NMActiveConnection *active;
+
+  gint64 request_time;
+  /* When the device entered its current state */
+  gint64 state_time;
+  gboolean started;
+  gboolean done;
+  gboolean activated;
+
+  gint64 stages[N_STAGES];
+};
+
+static GKeyFile *history;
+
+static int
+get_stage(NMDeviceState state)
+{
+  switch (state)
+  {
+  case NM_DEVICE_STATE_PREPARE:
+    return STAGE_PREPARE;
+  case NM_DEVICE_STATE_CONFIG:
+    return STAGE_CONFIG;
+  case NM_DEVICE_STATE_NEED_AUTH:
+    return STAGE_NEED_AUTH;
+  case NM_DEVICE_STATE_IP_CONFIG:
+    return STAGE_IP_CONFIG;
+  case NM_DEVICE_STATE_IP_CHECK:
+  case NM_DEVICE_STATE_SECONDARIES:
+    return STAGE_IP_CHECK;
+  default:
+    return -1;
+  }
+}
+
+static char *
+get_history_path(void)
+{
+  return g_build_filename(g_get_user_state_dir(), "plenjos-settings", "connection-timing.ini", NULL);
+}
+
+static GKeyFile *
+get_history(void)
+{
+  if (!history)
+  {
+    char *path = get_history_path();
+
+    history = g_key_file_new();
+    /* A missing or broken file just means no history yet */
+    g_key_file_load_from_file(history, path, G_KEY_FILE_NONE, NULL);
+
+    g_free(path);
+  }
+
+  return history;
+}
+
+static void
+save_history(void)
+{
+  GError *error = NULL;
+  char *path = get_history_path();
+  char *dir = g_path_get_dirname(path);
+
+  if (g_mkdir_with_parents(dir, 0700) < 0 || !g_key_file_save_to_file(history, path, &error))
+  {
+    fprintf(stderr, "Failed to save connection timing. %s.\n", error ? error->message : g_strerror(errno));
+    fflush(stderr);
+    g_clear_error(&error);
+  }
+
+  g_free(dir);
+  g_free(path);
+}
+
+/* Appends value (in ms) to the key's list, dropping the oldest */
+static void
+append_value(GKeyFile *file, const char *group, const char *key, gint64 value)
+{
+  gsize length = 0;
+  int *old = g_key_file_get_integer_list(file, group, key, &length, NULL);
+  gsize skip = length >= HISTORY_LENGTH ? length - HISTORY_LENGTH + 1 : 0;
+  int values[HISTORY_LENGTH];
+  gsize n = 0;
+
+  for (gsize i = skip; i < length; i++)
+    values[n++] = old[i];
+  values[n++] = (int)MIN(value / 1000, G_MAXINT);
+
+  g_key_file_set_integer_list(file, group, key, values, n);
+  g_free(old);
+}
+
+static void
+record(ConnectionTiming *timing)
+{
+  GKeyFile *file = get_history();
+
+  g_key_file_set_int64(file, timing->uuid, "time", g_get_real_time() / G_USEC_PER_SEC);
+  g_key_file_set_string(file, timing->uuid, "result", timing->activated ? "activated" : "failed");
+  append_value(file, timing->uuid, "total", timing->state_time - timing->request_time);
+
+  for (int i = 0; i < N_STAGES; i++)
+    append_value(file, timing->uuid, stage_keys[i], timing->stages[i]);
+
+  save_history();
+}
+
+static void
+connection_timing_free(ConnectionTiming *timing)
+{
+  g_object_unref(timing->device);
+  g_clear_object(&timing->active);
+  g_free(timing->uuid);
+}
+
+/* Stops listening to the device without recording anything */
+static void
+stop(ConnectionTiming *timing)
+{
+  if (timing->done)
+    return;
+
+  timing->done = TRUE;
+  g_signal_handlers_disconnect_by_data(timing->device, timing);
+
+  g_rc_box_release_full(timing, (GDestroyNotify)connection_timing_free);
+}
+
+/* The device can finish before the activation callback has told us
+ * which connection it was, so whichever comes last records */
+static void
+finish(ConnectionTiming *timing, gboolean activated)
+{
+  timing->activated = activated;
+
+  if (timing->uuid)
+    record(timing);
+
+  stop(timing);
+}
+
+static void
+on_device_state_changed(NMDevice *device, guint new_state, guint old_state, guint reason, ConnectionTiming *timing)
+{
+  gint64 now = g_get_monotonic_time();
+  int stage = get_stage(old_state);
+
+  /* Once we know which activation is ours, only its transitions count.
+   * Another one may have been in flight when this was requested, or may
+   * take the device over (a second click); neither is ours to record. */
+  if (timing->active && nm_device_get_active_connection(device) != timing->active)
+  {
+    if (nm_active_connection_get_state(timing->active) >= NM_ACTIVE_CONNECTION_STATE_DEACTIVATING)
+      stop(timing);
+    return;
+  }
+
+  if (stage >= 0 && timing->started)
+    timing->stages[stage] += now - timing->state_time;
+  timing->state_time = now;
+
+  if (new_state == NM_DEVICE_STATE_PREPARE)
+    timing->started = TRUE;
+
+  /* A device that was connected goes through disconnected on the way.
+   * Reaching activated without having been prepared since the request
+   * means some earlier activation finished; wait for ours unless we
+   * already know it is this one. */
+  if (new_state == NM_DEVICE_STATE_ACTIVATED)
+  {
+    if (timing->started)
+      finish(timing, TRUE);
+    else if (timing->active)
+      stop(timing);
+  }
+  else if (timing->started && (new_state == NM_DEVICE_STATE_FAILED || new_state <= NM_DEVICE_STATE_DISCONNECTED))
+  {
+    finish(timing, FALSE);
+  }
+}
+
+ConnectionTiming *connection_timing_begin(NMDevice *device)
+{
+  g_return_val_if_fail(NM_IS_DEVICE(device), NULL);
+
+  ConnectionTiming *timing = g_rc_box_new0(ConnectionTiming);
+
+  timing->device = g_object_ref(device);
+  timing->request_time = g_get_monotonic_time();
+  timing->state_time = timing->request_time;
+
+  /* One reference for the device's signal, one for the caller */
+  g_signal_connect(device, "state-changed", G_CALLBACK(on_device_state_changed), timing);
+  g_rc_box_acquire(timing);
+
+  return timing;
+}
+
+void connection_timing_attach(ConnectionTiming *timing, NMActiveConnection *active)
+{
+  if (!active)
+  {
+    stop(timing);
+  }
+  else if (timing->done)
+  {
+    /* The device finished before we were told. A success only counts if
+     * it is the one we asked for. */
+    if (timing->started && (!timing->activated || nm_device_get_active_connection(timing->device) == active))
+    {
+      timing->uuid = g_strdup(nm_active_connection_get_uuid(active));
+      record(timing);
+    }
+  }
+  else if (nm_active_connection_get_state(active) == NM_ACTIVE_CONNECTION_STATE_ACTIVATED)
+  {
+    /* Already up, either before we asked (nothing to time) or before the
+     * device's own signal got here */
+    timing->uuid = g_strdup(nm_active_connection_get_uuid(active));
+
+    if (timing->started)
+    {
+      timing->state_time = g_get_monotonic_time();
+      finish(timing, TRUE);
+    }
+    else
+    {
+      stop(timing);
+    }
+  }
+  else if (nm_active_connection_get_state(active) >= NM_ACTIVE_CONNECTION_STATE_DEACTIVATING)
+  {
+    /* Gone before the device was told about it, so it may never move */
+    stop(timing);
+  }
+  else
+  {
+    timing->uuid = g_strdup(nm_active_connection_get_uuid(active));
+    timing->active = g_object_ref(active);
+  }
+
+  g_rc_box_release_full(timing, (GDestroyNotify)connection_timing_free);
+}
+
+static gboolean
+get_last_value(GKeyFile *file, const char *uuid, const char *key, int *value)
+{
+  gsize length = 0;
+  int *values = g_key_file_get_integer_list(file, uuid, key, &length, NULL);
+
+  if (length > 0)
+    *value = values[length - 1];
+
+  g_free(values);
+
+  return length > 0;
+}
+
+char *connection_timing_describe(const char *uuid)
+{
+  GKeyFile *file = get_history();
+  char *result;
+  int total, dhcp;
+
+  if (!uuid || !get_last_value(file, uuid, "total", &total))
+    return NULL;
+
+  result = g_key_file_get_string(file, uuid, "result", NULL);
+
+  if (g_strcmp0(result, "activated") != 0)
+  {
+    g_free(result);
+    return g_strdup_printf("Last connect failed after %.1f s", total / 1000.0);
+  }
+
+  g_free(result);
+
+  if (get_last_value(file, uuid, "ip-config", &dhcp))
+    return g_strdup_printf("Last connect %.1f s, DHCP %.1f s", total / 1000.0, dhcp / 1000.0);
+
+  return g_strdup_printf("Last connect %.1f s", total / 1000.0);
+}
@@ -0,0 +1,46 @@
+/* connection-timing.h
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <NetworkManager.h>
+
+G_BEGIN_DECLS
+
+/* Times connection activations through the device's states (prepare,
+ * config, need-auth, ip-config, ip-check) and keeps the last few
+ * results per connection in $XDG_STATE_HOME/plenjos-settings, so slow
+ * DHCP or 802.1X on one network shows up in numbers.
+ */
+typedef struct ConnectionTiming ConnectionTiming;
+
+/* Call right before asking NetworkManager to activate on device. */
+ConnectionTiming *connection_timing_begin(NMDevice *device);
+
+/* Call from the activation callback with its result, or NULL if the
+ * request failed. Releases the reference from connection_timing_begin().
+ * From then on only that activation is timed, and the history is written
+ * once it is activated or gives up. Nothing is written if the device was
+ * never prepared for it, e.g. when it was already active. */
+void connection_timing_attach(ConnectionTiming *timing, NMActiveConnection *active);
+
+/* Returns a summary of the last activation of the connection, e.g.
+ * "Last connect 1.8 s, DHCP 1.2 s", or NULL if there is none. */
+char *connection_timing_describe(const char *uuid);
+
+G_END_DECLS
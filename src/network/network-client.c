@@ -0,0 +1,386 @@
+/* network-client.c
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "settings-config.h"
+#include "network-client.h"
+#include "settings-profiler.h"
+#include "connection-timing.h"
+
+#include <stdio.h>
+
+static NMClient *shared_client = NULL;
+
+/* GTasks waiting for nm_client_new_async() to finish */
+static GList *pending_tasks = NULL;
+static gboolean client_loading = FALSE;
+
+typedef struct IndexedConnection
+{
+  char *key;
+  GBytes *ssid;
+} IndexedConnection;
+
+/* Index key -> GPtrArray of NMConnection, referenced */
+static GHashTable *connections_by_key = NULL;
+/* NMConnection -> IndexedConnection, for taking it out again */
+static GHashTable *indexed_connections = NULL;
+/* SSID (GBytes) -> number of saved connections for it */
+static GHashTable *ssid_counts = NULL;
+
+static void
+indexed_connection_free(IndexedConnection *indexed)
+{
+  g_free(indexed->key);
+  g_bytes_unref(indexed->ssid);
+  g_free(indexed);
+}
+
+static char *
+get_connection_key(NMConnection *connection, GBytes **ssid_out)
+{
+  NMSettingWireless *s_wifi = nm_connection_get_setting_wireless(connection);
+  NMSettingWirelessSecurity *s_wsec;
+  const char *mode, *key_mgmt;
+  GBytes *ssid;
+  char *ssid_hex, *key;
+
+  ssid = s_wifi ? nm_setting_wireless_get_ssid(s_wifi) : NULL;
+  if (!ssid)
+    return NULL;
+
+  /* Spell out the defaults so an unset value matches an explicit one */
+  mode = nm_setting_wireless_get_mode(s_wifi);
+  if (!mode)
+    mode = NM_SETTING_WIRELESS_MODE_INFRA;
+
+  s_wsec = nm_connection_get_setting_wireless_security(connection);
+  key_mgmt = s_wsec ? nm_setting_wireless_security_get_key_mgmt(s_wsec) : NULL;
+  if (!key_mgmt)
+    key_mgmt = "none";
+
+  ssid_hex = nm_utils_bin2hexstr(g_bytes_get_data(ssid, NULL), g_bytes_get_size(ssid), -1);
+  key = g_strdup_printf("%s|%s|%s", ssid_hex, mode, key_mgmt);
+  g_free(ssid_hex);
+
+  if (ssid_out)
+    *ssid_out = ssid;
+
+  return key;
+}
+
+static void
+index_connection(NMConnection *connection)
+{
+  IndexedConnection *indexed;
+  GPtrArray *candidates;
+  GBytes *ssid = NULL;
+  char *key = get_connection_key(connection, &ssid);
+
+  if (!key)
+    return;
+
+  candidates = g_hash_table_lookup(connections_by_key, key);
+  if (!candidates)
+  {
+    candidates = g_ptr_array_new_with_free_func(g_object_unref);
+    g_hash_table_insert(connections_by_key, g_strdup(key), candidates);
+  }
+  g_ptr_array_add(candidates, g_object_ref(connection));
+
+  g_hash_table_insert(ssid_counts, g_bytes_ref(ssid), GUINT_TO_POINTER(GPOINTER_TO_UINT(g_hash_table_lookup(ssid_counts, ssid)) + 1));
+
+  indexed = g_new(IndexedConnection, 1);
+  indexed->key = key;
+  indexed->ssid = g_bytes_ref(ssid);
+  g_hash_table_insert(indexed_connections, connection, indexed);
+}
+
+static void
+unindex_connection(NMConnection *connection)
+{
+  IndexedConnection *indexed = g_hash_table_lookup(indexed_connections, connection);
+  GPtrArray *candidates;
+  guint count;
+
+  if (!indexed)
+    return;
+
+  candidates = g_hash_table_lookup(connections_by_key, indexed->key);
+  g_ptr_array_remove_fast(candidates, connection);
+  if (candidates->len == 0)
+    g_hash_table_remove(connections_by_key, indexed->key);
+
+  count = GPOINTER_TO_UINT(g_hash_table_lookup(ssid_counts, indexed->ssid));
+  if (count > 1)
+    g_hash_table_insert(ssid_counts, g_bytes_ref(indexed->ssid), GUINT_TO_POINTER(count - 1));
+  else
+    g_hash_table_remove(ssid_counts, indexed->ssid);
+
+  g_hash_table_remove(indexed_connections, connection);
+}
+
+static void
+on_connection_changed(NMConnection *connection, gpointer user_data)
+{
+  /* The SSID or security may have been edited */
+  unindex_connection(connection);
+  index_connection(connection);
+}
+
+static void
+on_connection_added(NMClient *client, NMRemoteConnection *connection, gpointer user_data)
+{
+  index_connection(NM_CONNECTION(connection));
+  g_signal_connect(connection, "changed", G_CALLBACK(on_connection_changed), NULL);
+}
+
+static void
+on_connection_removed(NMClient *client, NMRemoteConnection *connection, gpointer user_data)
+{
+  g_signal_handlers_disconnect_by_func(connection, on_connection_changed, NULL);
+  unindex_connection(NM_CONNECTION(connection));
+}
+
+static void
+build_connection_index(NMClient *client)
+{
+  const GPtrArray *connections = nm_client_get_connections(client);
+
+  connections_by_key = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_ptr_array_unref);
+  indexed_connections = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)indexed_connection_free);
+  ssid_counts = g_hash_table_new_full(g_bytes_hash, g_bytes_equal, (GDestroyNotify)g_bytes_unref, NULL);
+
+  for (guint i = 0; i < connections->len; i++)
+    on_connection_added(client, connections->pdata[i], NULL);
+
+  /* Connected before any page connects, so pages see an updated index */
+  g_signal_connect(client, NM_CLIENT_CONNECTION_ADDED, G_CALLBACK(on_connection_added), NULL);
+  g_signal_connect(client, NM_CLIENT_CONNECTION_REMOVED, G_CALLBACK(on_connection_removed), NULL);
+}
+
+static void
+on_client_ready(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+  GError *error = NULL;
+  GList *tasks = pending_tasks;
+
+  pending_tasks = NULL;
+  client_loading = FALSE;
+
+  shared_client = nm_client_new_finish(result, &error);
+
+  settings_profiler_end("nm-client");
+
+  if (shared_client)
+  {
+    g_print("NetworkManager version: %s\n", nm_client_get_version(shared_client));
+    gint64 start = g_get_monotonic_time();
+    build_connection_index(shared_client);
+    settings_profiler_sample("nm:connection-index", start);
+  }
+
+  for (GList *item = g_list_reverse(tasks); item; item = item->next)
+  {
+    GTask *task = G_TASK(item->data);
+
+    if (shared_client)
+      g_task_return_pointer(task, g_object_ref(shared_client), g_object_unref);
+    else
+      g_task_return_error(task, g_error_copy(error));
+
+    g_object_unref(task);
+  }
+
+  g_list_free(tasks);
+  g_clear_error(&error);
+}
+
+void network_client_get_async(GCancellable *cancellable,
+                              GAsyncReadyCallback callback,
+                              gpointer user_data)
+{
+  GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+  g_task_set_source_tag(task, network_client_get_async);
+
+  if (shared_client)
+  {
+    g_task_return_pointer(task, g_object_ref(shared_client), g_object_unref);
+    g_object_unref(task);
+    return;
+  }
+
+  pending_tasks = g_list_prepend(pending_tasks, task);
+
+  /* A failed attempt leaves shared_client unset, so the next caller retries */
+  if (!client_loading)
+  {
+    client_loading = TRUE;
+    settings_profiler_begin("nm-client");
+    nm_client_new_async(NULL, on_client_ready, NULL);
+  }
+}
+
+NMClient *network_client_get_finish(GAsyncResult *result,
+                                    GError **error)
+{
+  g_return_val_if_fail(g_task_is_valid(result, NULL), NULL);
+  g_return_val_if_fail(g_task_get_source_tag(G_TASK(result)) == network_client_get_async, NULL);
+
+  return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+NMClient *network_client_peek(void)
+{
+  return shared_client;
+}
+
+NMConnection *network_client_find_similar_connection(NMConnection *connection)
+{
+  GPtrArray *candidates;
+  char *key;
+
+  if (!connections_by_key)
+    return NULL;
+
+  key = get_connection_key(connection, NULL);
+  candidates = key ? g_hash_table_lookup(connections_by_key, key) : NULL;
+  g_free(key);
+
+  if (!candidates)
+    return NULL;
+
+  for (guint i = 0; i < candidates->len; i++)
+  {
+    if (nm_connection_compare(connection,
+                              NM_CONNECTION(candidates->pdata[i]),
+                              (NM_SETTING_COMPARE_FLAG_FUZZY | NM_SETTING_COMPARE_FLAG_IGNORE_ID)))
+      return NM_CONNECTION(candidates->pdata[i]);
+  }
+
+  return NULL;
+}
+
+gboolean network_client_has_connection_for_ssid(GBytes *ssid)
+{
+  return ssid_counts && g_hash_table_contains(ssid_counts, ssid);
+}
+
+typedef struct CommitRequest
+{
+  NMRemoteConnection *connection;
+  NMDevice *device;
+} CommitRequest;
+
+static void
+commit_request_free(CommitRequest *request)
+{
+  g_object_unref(request->connection);
+  g_object_unref(request->device);
+  g_free(request);
+}
+
+static gboolean
+is_active_on_device(CommitRequest *request)
+{
+  NMActiveConnection *active = nm_device_get_active_connection(request->device);
+
+  return active && nm_active_connection_get_connection(active) == request->connection;
+}
+
+static void
+on_reactivated(GObject *client, GAsyncResult *result, gpointer user_data)
+{
+  GError *error = NULL;
+  NMActiveConnection *active = nm_client_activate_connection_finish(NM_CLIENT(client), result, &error);
+
+  connection_timing_attach(user_data, active);
+  g_clear_object(&active);
+
+  if (error)
+  {
+    fprintf(stderr, "Failed to reactivate the connection. %s.\n", error->message);
+    fflush(stderr);
+    g_error_free(error);
+  }
+}
+
+static void
+on_reapplied(GObject *device, GAsyncResult *result, gpointer user_data)
+{
+  CommitRequest *request = user_data;
+  GError *error = NULL;
+
+  /* NM refuses to reapply some settings, most 802-11-wireless ones for
+   * example, so reconnect for those */
+  if (!nm_device_reapply_finish(NM_DEVICE(device), result, &error))
+  {
+    g_error_free(error);
+
+    if (shared_client && is_active_on_device(request))
+    {
+      nm_client_activate_connection_async(shared_client,
+                                          NM_CONNECTION(request->connection),
+                                          request->device,
+                                          NULL,
+                                          NULL,
+                                          on_reactivated,
+                                          connection_timing_begin(request->device));
+    }
+  }
+
+  commit_request_free(request);
+}
+
+static void
+on_committed(GObject *connection, GAsyncResult *result, gpointer user_data)
+{
+  CommitRequest *request = user_data;
+  GError *error = NULL;
+
+  if (!nm_remote_connection_commit_changes_finish(NM_REMOTE_CONNECTION(connection), result, &error))
+  {
+    fprintf(stderr, "Failed to save the connection. %s.\n", error->message);
+    fflush(stderr);
+    g_error_free(error);
+    commit_request_free(request);
+    return;
+  }
+
+  /* Saved for next time; nothing to do now if it's no longer up here */
+  if (!is_active_on_device(request))
+  {
+    commit_request_free(request);
+    return;
+  }
+
+  nm_device_reapply_async(request->device, NM_CONNECTION(request->connection), 0, 0, NULL, on_reapplied, request);
+}
+
+void network_client_commit_and_reapply(NMRemoteConnection *connection, NMDevice *device)
+{
+  CommitRequest *request;
+
+  g_return_if_fail(NM_IS_REMOTE_CONNECTION(connection));
+  g_return_if_fail(NM_IS_DEVICE(device));
+
+  request = g_new(CommitRequest, 1);
+  request->connection = g_object_ref(connection);
+  request->device = g_object_ref(device);
+
+  nm_remote_connection_commit_changes_async(connection, TRUE, NULL, on_committed, request);
+}
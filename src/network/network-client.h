@@ -0,0 +1,56 @@
+/* network-client.h
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include <NetworkManager.h>
+
+G_BEGIN_DECLS
+
+/* A single NMClient shared by every page in the process. It is created
+ * asynchronously the first time it is asked for; callers that arrive
+ * while it is still loading are completed together once it is ready.
+ */
+void network_client_get_async(GCancellable *cancellable,
+                              GAsyncReadyCallback callback,
+                              gpointer user_data);
+NMClient *network_client_get_finish(GAsyncResult *result,
+                                    GError **error);
+
+/* Returns the shared client without a new reference, or NULL if it
+ * hasn't finished loading yet. */
+NMClient *network_client_peek(void);
+
+/* Saved Wi-Fi connections are indexed by SSID, mode and key management as
+ * they are added, changed and removed, so these don't walk every profile.
+ * Both return nothing until the shared client is ready. */
+
+/* Returns the saved connection (without a new reference) that fuzzily
+ * matches connection, or NULL. Only profiles with the same key are
+ * compared. */
+NMConnection *network_client_find_similar_connection(NMConnection *connection);
+gboolean network_client_has_connection_for_ssid(GBytes *ssid);
+
+/* Saves the changes made to connection with one commit and, if it is
+ * active on device, reapplies them there. The connection is only
+ * reactivated when NM refuses to reapply a change. */
+void network_client_commit_and_reapply(NMRemoteConnection *connection, NMDevice *device);
+
+G_END_DECLS
@@ -18,6 +18,16 @@
 
 #include "settings-config.h"
 #include "network-settings-window.h"
+#include "connection-timing.h"
+#include "network-client.h"
+#include "network-stats-graph.h"
+#include "saved-networks-page.h"
+#include "wifi-channel-view.h"
+#include "wifi-connection-options.h"
+#include "wifi-scan-cache.h"
+#include "wired-link-view.h"
+#include "settings-profiler.h"
+#include "wifi-network.h"
 
 struct _NetworkSettingsWindow
 {
@@ -27,20 +37,84 @@ struct _NetworkSettingsWindow
 
   AdwNavigationView *interfaces_view;
 
+  /* Unmanaged virtual devices only get counted here */
+  AdwPreferencesGroup *virtual_devices_group;
+  AdwActionRow *virtual_devices_row;
+  guint n_virtual_devices;
+
+  AdwPreferencesGroup *saved_networks_group;
+  AdwActionRow *saved_networks_row;
+
+  /* Owned by interfaces_view while pushed, NULL otherwise */
+  AdwNavigationPage *saved_networks_page;
+
+  /* Shown in interfaces_group until the shared client is ready */
+  AdwActionRow *loading_row;
+  GtkWidget *loading_spinner;
+  GCancellable *cancellable;
+
   NMClient *nm_client;
+
+  /* Every NMDevice, referenced -> its NetworkSettingsInterface, or NULL
+   * while it is only counted in virtual_devices_row */
+  GHashTable *devices;
+
+  GPowerProfileMonitor *power_monitor;
+
+  /* Interface name from network_settings_window_show_device() that
+   * NetworkManager hasn't reported yet */
+  char *pending_device;
 };
 
 G_DEFINE_TYPE(NetworkSettingsWindow, network_settings_window, ADW_TYPE_NAVIGATION_PAGE)
 
-static void
-network_settings_window_class_init(NetworkSettingsWindowClass *klass)
+/* Everything behind an open Wi-Fi page. It is allocated when the page
+ * is built and freed in one go when the page is popped or the device
+ * goes away, so nothing in it can outlive the page. */
+typedef struct NetworkSettingsWifiPage
 {
-  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
-
-  gtk_widget_class_set_template_from_resource(widget_class, "/com/plenjos/Settings/network/network-settings-window.ui");
-  gtk_widget_class_bind_template_child(widget_class, NetworkSettingsWindow, interfaces_group);
-  gtk_widget_class_bind_template_child(widget_class, NetworkSettingsWindow, interfaces_view);
-}
+  GPtrArray *aps;
+  GtkBuilder *builder;
+  GtkListView *list;
+
+  /* WifiNetwork, shown by list. Rows are recycled, so only the
+   * visible networks have widgets. */
+  GListStore *store;
+
+  /* Network hash -> WifiNetwork, and NMAccessPoint -> the WifiNetwork it
+   * was merged into, so an AP is added or removed without a scan */
+  GHashTable *networks;
+  GHashTable *ap_networks;
+
+  /* Fed every BSSID, hidden and denylisted ones included, since they
+   * take up airtime all the same */
+  WifiChannelView *channels;
+
+  /* Sets of NMAccessPoint, referenced, waiting to be applied together */
+  GHashTable *pending_added;
+  GHashTable *pending_removed;
+  guint flush_source;
+  /* When the oldest pending change came in, for the profiler */
+  gint64 pending_since;
+
+  /* Set of WifiNetwork, referenced, whose sort key has gone stale */
+  GHashTable *pending_resort;
+  guint resort_source;
+
+  /* Not referenced; cleared when the network goes away */
+  WifiNetwork *connected_network;
+
+  /* Networks restored from the scan cache are listed until the first
+   * scan finishes, then dropped if it didn't see them */
+  gboolean has_cached_networks;
+  gboolean prune_cached_networks;
+
+  /* Only scans while the Wi-Fi page is mapped */
+  GCancellable *scan_cancellable;
+  guint scan_source;
+  guint scan_interval;
+  gboolean scan_results_changed;
+} NetworkSettingsWifiPage;
 
 typedef struct NetworkSettingsInterface
 {
@@ -53,55 +127,140 @@ typedef struct NetworkSettingsInterface
 
   NetworkSettingsWindow *self;
 
-  /* Wi-Fi */
-  GPtrArray *aps;
-  GtkBuilder *wifi_builder;
-  AdwPreferencesGroup *wifi_group;
-  GList *aps_args;
+  /* Only while the page exists */
+  GtkLabel *timing_label;
+
+  /* Only while the page exists, and only for Wi-Fi devices */
+  struct NetworkSettingsWifiPage *wifi;
 } NetworkSettingsInterface;
 
-typedef struct WifiArgs
+/* A scan reports every BSSID on its own. Wait this long for the rest of
+ * the burst so the list changes once per scan rather than once per AP. */
+#define AP_FLUSH_DELAY_MS 100
+
+/* Networks that need to move are moved together at most this often, and
+ * less often in power saver mode */
+#define RESORT_INTERVAL_MS 1000
+#define RESORT_INTERVAL_POWER_SAVER_MS 5000
+
+/* While the Wi-Fi page is up, rescan at the shortest interval as long as
+ * scans keep turning up changes and double it each time they don't.
+ * Every scan takes the radio off the active channel for a moment. */
+#define SCAN_INTERVAL_MIN_S 10
+#define SCAN_INTERVAL_MAX_S 120
+#define SCAN_INTERVAL_POWER_SAVER_MIN_S 30
+#define SCAN_INTERVAL_POWER_SAVER_MAX_S 300
+
+/* Results younger than this, from whoever asked for them, are used as is */
+#define SCAN_MAX_AGE_MS 8000
+
+static void stop_scanning(NetworkSettingsInterface *iface);
+
+static void
+wifi_page_free(NetworkSettingsWifiPage *wifi, NetworkSettingsInterface *iface)
 {
-  NMAccessPoint *ap;
-  NetworkSettingsInterface *iface;
-  AdwActionRow *row;
-  char *hash;
-} WifiArgs;
+  g_signal_handlers_disconnect_by_data(wifi->list, iface);
+
+  stop_scanning(iface);
+  g_clear_handle_id(&wifi->flush_source, g_source_remove);
+  g_clear_handle_id(&wifi->resort_source, g_source_remove);
+  g_hash_table_unref(wifi->pending_added);
+  g_hash_table_unref(wifi->pending_removed);
+  g_hash_table_unref(wifi->pending_resort);
+  g_hash_table_unref(wifi->ap_networks);
+
+  GHashTableIter iter;
+  gpointer network;
+
+  /* Bound rows may keep a network alive a little longer */
+  g_hash_table_iter_init(&iter, wifi->networks);
+  while (g_hash_table_iter_next(&iter, NULL, &network))
+    g_signal_handlers_disconnect_by_data(network, iface);
+
+  g_hash_table_unref(wifi->networks);
+  wifi_scan_cache_save(NM_DEVICE_WIFI(iface->device), G_LIST_MODEL(wifi->store));
+  g_object_unref(wifi->store);
+  g_object_unref(wifi->builder);
+
+  g_free(wifi);
+}
 
-static void on_iface_activated(AdwActionRow *row, NetworkSettingsInterface *iface)
+/* Drops the interface's page and everything that only exists to fill it.
+ * The page itself goes once the navigation view lets go of it. */
+static void
+destroy_interface_page(NetworkSettingsInterface *iface)
 {
-  adw_navigation_view_push(iface->self->interfaces_view, iface->iface_page);
-  printf("test\n");
-  fflush(stdout);
+  /* The AP, active AP and page header handlers */
+  g_signal_handlers_disconnect_by_data(iface->device, iface);
+
+  if (iface->iface_page)
+    g_signal_handlers_disconnect_by_data(iface->iface_page, iface);
+
+  if (iface->wifi)
+    wifi_page_free(iface->wifi, iface);
+
+  iface->wifi = NULL;
+  iface->iface_page = NULL;
+  iface->timing_label = NULL;
 }
 
 static void
-clamp_ap_to_bssid(NMAccessPoint *ap, NMSettingWireless *s_wifi)
+network_settings_interface_free(NetworkSettingsInterface *iface)
 {
-  const char *str_bssid;
-  struct ether_addr *eth_addr;
-  GByteArray *bssid;
+  if (!iface)
+    return;
 
-  /* For a certain list of known ESSIDs which are commonly preset by ISPs
-   * and manufacturers and often unchanged by users, lock the connection
-   * to the BSSID so that we don't try to auto-connect to your grandma's
-   * neighbor's Wi-Fi.
-   */
+  destroy_interface_page(iface);
 
-  str_bssid = nm_access_point_get_bssid(ap);
-  if (str_bssid)
+  g_free(iface->title);
+  g_free(iface);
+}
+
+static void
+network_settings_window_dispose(GObject *object)
+{
+  NetworkSettingsWindow *self = NETWORK_SETTINGS_WINDOW(object);
+
+  g_cancellable_cancel(self->cancellable);
+  g_clear_object(&self->cancellable);
+
+  /* The page is destroyed when it has been hidden for a while, so stop
+   * listening to the devices, which outlive it in the shared client */
+  if (self->devices)
   {
-    eth_addr = ether_aton(str_bssid);
-    if (eth_addr)
-    {
-      bssid = g_byte_array_sized_new(ETH_ALEN);
-      g_byte_array_append(bssid, eth_addr->ether_addr_octet, ETH_ALEN);
-      g_object_set(G_OBJECT(s_wifi),
-                   NM_SETTING_WIRELESS_BSSID, bssid,
-                   NULL);
-      g_byte_array_free(bssid, TRUE);
-    }
+    GHashTableIter iter;
+    gpointer device;
+
+    g_hash_table_iter_init(&iter, self->devices);
+    while (g_hash_table_iter_next(&iter, &device, NULL))
+      g_signal_handlers_disconnect_by_data(device, self);
   }
+  g_clear_pointer(&self->devices, g_hash_table_unref);
+
+  if (self->nm_client)
+    g_signal_handlers_disconnect_by_data(self->nm_client, self);
+  g_clear_object(&self->nm_client);
+  g_clear_object(&self->power_monitor);
+  g_clear_pointer(&self->pending_device, g_free);
+
+  G_OBJECT_CLASS(network_settings_window_parent_class)->dispose(object);
+}
+
+static void
+network_settings_window_class_init(NetworkSettingsWindowClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+
+  object_class->dispose = network_settings_window_dispose;
+
+  gtk_widget_class_set_template_from_resource(widget_class, "/com/plenjos/Settings/network/network-settings-window.ui");
+  gtk_widget_class_bind_template_child(widget_class, NetworkSettingsWindow, interfaces_group);
+  gtk_widget_class_bind_template_child(widget_class, NetworkSettingsWindow, interfaces_view);
+  gtk_widget_class_bind_template_child(widget_class, NetworkSettingsWindow, virtual_devices_group);
+  gtk_widget_class_bind_template_child(widget_class, NetworkSettingsWindow, virtual_devices_row);
+  gtk_widget_class_bind_template_child(widget_class, NetworkSettingsWindow, saved_networks_group);
+  gtk_widget_class_bind_template_child(widget_class, NetworkSettingsWindow, saved_networks_row);
 }
 
 /*
@@ -141,31 +300,6 @@ is_manufacturer_default_ssid(GBytes *ssid)
   return is_ssid_in_list(ssid, manf_default_ssids);
 }
 
-static GPtrArray *
-get_all_connections(NMClient *nm_client)
-{
-  const GPtrArray *all_connections;
-  GPtrArray *connections;
-  int i;
-  NMConnection *connection;
-  NMSettingConnection *s_con;
-
-  all_connections = nm_client_get_connections(nm_client);
-  connections = g_ptr_array_new_full(all_connections->len, g_object_unref);
-
-  /* Ignore port connections unless they are wifi connections */
-  for (i = 0; i < all_connections->len; i++)
-  {
-    connection = all_connections->pdata[i];
-
-    s_con = nm_connection_get_setting_connection(connection);
-    if (s_con && (!nm_setting_connection_get_master(s_con) || nm_connection_get_setting_wireless(connection)))
-      g_ptr_array_add(connections, g_object_ref(connection));
-  }
-
-  return connections;
-}
-
 static void
 activate_existing_cb(GObject *client,
                      GAsyncResult *result,
@@ -175,6 +309,8 @@ activate_existing_cb(GObject *client,
   NMActiveConnection *active;
 
   active = nm_client_activate_connection_finish(NM_CLIENT(client), result, &error);
+  if (user_data)
+    connection_timing_attach(user_data, active);
   g_clear_object(&active);
   if (error)
   {
@@ -192,12 +328,14 @@ activate_existing_cb(GObject *client,
 static void
 activate_new_cb(GObject *client,
                 GAsyncResult *result,
-                WifiArgs *args)
+                gpointer user_data)
 {
   GError *error = NULL;
   NMActiveConnection *active;
 
   active = nm_client_add_and_activate_connection_finish(NM_CLIENT(client), result, &error);
+  if (user_data)
+    connection_timing_attach(user_data, active);
   g_clear_object(&active);
   if (error)
   {
@@ -215,15 +353,13 @@ activate_new_cb(GObject *client,
 static void
 wifi_dialog_response_cb(GtkDialog *foo,
                         gint response,
-                        WifiArgs *args)
+                        gpointer user_data)
 {
   NMAWifiDialog *dialog = NMA_WIFI_DIALOG(foo);
   // NMApplet *applet = NM_APPLET (user_data);
   NMConnection *connection = NULL, *fuzzy_match = NULL;
   NMDevice *device = NULL;
   NMAccessPoint *ap = NULL;
-  GPtrArray *all;
-  int i;
 
   if (response != GTK_RESPONSE_OK)
     goto done;
@@ -236,30 +372,17 @@ wifi_dialog_response_cb(GtkDialog *foo,
   g_assert(device);
 
   /* Find a similar connection and use that instead */
-  all = get_all_connections(args->iface->self->nm_client);
-  for (i = 0; i < (int)all->len; i++)
-  {
-    if (nm_connection_compare(connection,
-                              NM_CONNECTION(all->pdata[i]),
-                              (NM_SETTING_COMPARE_FLAG_FUZZY | NM_SETTING_COMPARE_FLAG_IGNORE_ID)))
-    {
-      fuzzy_match = NM_CONNECTION(all->pdata[i]);
-      printf("match");
-      fflush(stdout);
-      break;
-    }
-  }
-  g_ptr_array_unref(all);
+  fuzzy_match = network_client_find_similar_connection(connection);
 
   if (fuzzy_match)
   {
-    nm_client_activate_connection_async(args->iface->self->nm_client,
+    nm_client_activate_connection_async(network_client_peek(),
                                         fuzzy_match,
                                         device,
                                         ap ? nm_object_get_path(NM_OBJECT(ap)) : NULL,
                                         NULL,
                                         activate_existing_cb,
-                                        args);
+                                        connection_timing_begin(device));
   }
   else
   {
@@ -284,13 +407,13 @@ wifi_dialog_response_cb(GtkDialog *foo,
       g_object_set(G_OBJECT(s_con), NM_SETTING_CONNECTION_AUTOCONNECT, FALSE, NULL);
     }
 
-    nm_client_add_and_activate_connection_async(args->iface->self->nm_client,
+    nm_client_add_and_activate_connection_async(network_client_peek(),
                                                 connection,
                                                 device,
                                                 ap ? nm_object_get_path(NM_OBJECT(ap)) : NULL,
                                                 NULL,
-                                                (GAsyncReadyCallback)activate_new_cb,
-                                                args);
+                                                activate_new_cb,
+                                                connection_timing_begin(device));
   }
 
   /* Balance nma_wifi_dialog_get_connection() */
@@ -303,7 +426,7 @@ done:
 static void
 wifi_dialog_response(GtkDialog *foo,
                      gint response,
-                     WifiArgs *args)
+                     gpointer user_data)
 {
   NMAWifiDialog *dialog = NMA_WIFI_DIALOG(foo);
   NMConnection *connection = NULL, *fuzzy_match = NULL;
@@ -340,13 +463,13 @@ wifi_dialog_response(GtkDialog *foo,
     g_object_set(G_OBJECT(s_con), NM_SETTING_CONNECTION_AUTOCONNECT, FALSE, NULL);
   }
 
-  nm_client_add_and_activate_connection_async(args->iface->self->nm_client,
+  nm_client_add_and_activate_connection_async(network_client_peek(),
                                               connection,
                                               device,
                                               ap ? nm_object_get_path(NM_OBJECT(ap)) : NULL,
                                               NULL,
-                                              (GAsyncReadyCallback)activate_existing_cb,
-                                              args);
+                                              activate_existing_cb,
+                                              NULL);
 
   /* Balance nma_wifi_dialog_get_connection() */
   g_object_unref(connection);
@@ -355,11 +478,32 @@ done:
   gtk_window_close(GTK_WINDOW(dialog));
 }
 
-static void on_wifi_activated(AdwActionRow *row, WifiArgs *args)
+static void on_wifi_activated(GtkListView *list, guint position, NetworkSettingsInterface *iface)
 {
+  WifiNetwork *network = g_list_model_get_item(G_LIST_MODEL(gtk_list_view_get_model(list)), position);
+
+  if (!network)
+    return;
+
+  /* Cached, and not seen by a scan yet */
+  if (!wifi_network_get_best_access_point(network))
+  {
+    g_object_unref(network);
+    return;
+  }
+
+  /* Already there, so offer what can be tuned instead */
+  if (wifi_network_get_connected(network))
+  {
+    wifi_connection_options_present(GTK_WIDGET(list), NM_DEVICE_WIFI(iface->device), network);
+    g_object_unref(network);
+    return;
+  }
+
   NMConnection *connection = nm_simple_connection_new();
 
-  NMAccessPoint *ap = args->ap;
+  /* Let NetworkManager roam between the BSSIDs; start with the closest */
+  NMAccessPoint *ap = wifi_network_get_best_access_point(network);
 
   NMSettingConnection *s_con = NULL;
   NMSettingWireless *s_wifi = NULL;
@@ -384,7 +528,7 @@ static void on_wifi_activated(AdwActionRow *row, WifiArgs *args)
     /* Lock connection to this AP if it's a manufacturer-default SSID
      * so that we don't randomly connect to some other 'linksys'
      */
-    clamp_ap_to_bssid(ap, s_wifi);
+    wifi_connection_clamp_ap_to_bssid(ap, s_wifi);
   }
 
   /* Need a UUID for the "always ask" stuff in the Dialog of Doom */
@@ -412,14 +556,18 @@ static void on_wifi_activated(AdwActionRow *row, WifiArgs *args)
     nm_connection_add_setting(connection, NM_SETTING(s_8021x));
   }
 
-  dialog = nma_wifi_dialog_new(args->iface->self->nm_client, connection, args->iface->device, ap, FALSE);
+  dialog = nma_wifi_dialog_new(network_client_peek(), connection, iface->device, ap, FALSE);
+  g_object_unref(connection);
+  g_object_unref(network);
+
+  if (!dialog)
+    return;
 
-  if (dialog)
-  {
-    g_signal_connect(dialog, "response",
-                     G_CALLBACK(wifi_dialog_response_cb),
-                     args);
-  }
+  /* The network may be gone by the time the dialog is answered, and the
+   * dialog reports the device and AP itself */
+  g_signal_connect(dialog, "response",
+                   G_CALLBACK(wifi_dialog_response_cb),
+                   NULL);
 
   gtk_window_present(GTK_WINDOW(dialog));
 }
@@ -436,179 +584,681 @@ is_denylisted_ssid(GBytes *ssid)
   return is_ssid_in_list(ssid, denylisted_ssids);
 }
 
-struct dup_data
+static void
+wifi_row_update(WifiNetwork *network, GParamSpec *pspec, GtkListItem *list_item)
 {
-  NetworkSettingsInterface *iface;
-  WifiArgs *found;
-  char *hash;
-};
+  GtkWidget *labels = gtk_widget_get_first_child(gtk_list_item_get_child(list_item));
+  GtkWidget *subtitle = gtk_widget_get_last_child(labels);
+  GtkWidget *strength = gtk_widget_get_next_sibling(labels);
+  guint n_aps = wifi_network_get_n_access_points(network);
+
+  gtk_image_set_from_icon_name(GTK_IMAGE(strength), wifi_network_get_icon_name(network));
 
+  gtk_widget_set_opacity(gtk_list_item_get_child(list_item), wifi_network_get_stale(network) ? 0.55 : 1);
+
+  if (wifi_network_get_connected(network))
+  {
+    gtk_label_set_label(GTK_LABEL(subtitle), "Connected");
+  }
+  else if (wifi_network_get_stale(network))
+  {
+    gtk_label_set_label(GTK_LABEL(subtitle), "From an earlier scan");
+  }
+  else if (n_aps > 1)
+  {
+    char *text = g_strdup_printf("%u access points", n_aps);
+    gtk_label_set_label(GTK_LABEL(subtitle), text);
+    g_free(text);
+  }
+  gtk_widget_set_visible(subtitle, wifi_network_get_connected(network) || wifi_network_get_stale(network) || n_aps > 1);
+}
+
+/* Moves every network in pending_resort to its new place. Each is
+ * replaced by itself in the store, so the sort model only moves that one
+ * item instead of sorting the whole list again. */
 static void
-find_duplicate(gpointer d, gpointer user_data)
+apply_resort(NetworkSettingsInterface *iface)
 {
-  struct dup_data *data = (struct dup_data *)user_data;
-  NMDevice *device;
-  const char *hash;
-  WifiArgs *args = (WifiArgs *)d;
+  GListModel *model = G_LIST_MODEL(iface->wifi->store);
+  guint n_items = g_list_model_get_n_items(model);
+  guint n_left = g_hash_table_size(iface->wifi->pending_resort);
+
+  for (guint i = 0; i < n_items && n_left > 0; i++)
+  {
+    WifiNetwork *network = g_list_model_get_item(model, i);
 
-  g_assert(d && args);
-  g_return_if_fail(data);
-  g_return_if_fail(data->hash);
+    if (g_hash_table_contains(iface->wifi->pending_resort, network))
+    {
+      wifi_network_commit_sort_key(network);
+      g_list_store_splice(iface->wifi->store, i, 1, (gpointer *)&network, 1);
+      n_left--;
+    }
+
+    g_object_unref(network);
+  }
 
-  if (data->found /* || !ADW_IS_ACTION_ROW (widget) */)
+  g_hash_table_remove_all(iface->wifi->pending_resort);
+}
+
+static gboolean
+on_resort_timeout(NetworkSettingsInterface *iface)
+{
+  gint64 start = g_get_monotonic_time();
+
+  iface->wifi->resort_source = 0;
+  apply_resort(iface);
+
+  settings_profiler_sample("wifi:resort", start);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+on_network_notify(WifiNetwork *network, GParamSpec *pspec, NetworkSettingsInterface *iface)
+{
+  guint interval;
+
+  if (!wifi_network_sort_key_is_stale(network))
     return;
 
-  device = args->iface->device;
-  if (NM_DEVICE(device) != data->iface->device)
+  g_hash_table_add(iface->wifi->pending_resort, g_object_ref(network));
+
+  /* Throttle rather than debounce, so a list that never settles still
+   * gets reordered, just not more than once an interval */
+  if (iface->wifi->resort_source)
     return;
 
-  hash = args->hash;
-  if (hash && (strcmp(hash, data->hash) == 0))
-    data->found = args;
+  interval = g_power_profile_monitor_get_power_saver_enabled(iface->self->power_monitor) ? RESORT_INTERVAL_POWER_SAVER_MS : RESORT_INTERVAL_MS;
+  iface->wifi->resort_source = g_timeout_add(interval, (GSourceFunc)on_resort_timeout, iface);
+}
+
+static void
+update_connected_network(NetworkSettingsInterface *iface)
+{
+  NMAccessPoint *active = nm_device_wifi_get_active_access_point(NM_DEVICE_WIFI(iface->device));
+  WifiNetwork *network = active ? g_hash_table_lookup(iface->wifi->ap_networks, active) : NULL;
+
+  if (network == iface->wifi->connected_network)
+    return;
+
+  if (iface->wifi->connected_network)
+    wifi_network_set_connected(iface->wifi->connected_network, FALSE);
+
+  iface->wifi->connected_network = network;
+
+  if (network)
+    wifi_network_set_connected(network, TRUE);
+}
+
+static void
+on_active_access_point_changed(NMDeviceWifi *device, GParamSpec *pspec, NetworkSettingsInterface *iface)
+{
+  update_connected_network(iface);
+  wifi_channel_view_set_active_access_point(iface->wifi->channels, nm_device_wifi_get_active_access_point(device));
+}
+
+static void
+wifi_row_setup(GtkSignalListItemFactory *factory, GtkListItem *list_item, gpointer user_data)
+{
+  GtkBox *box = GTK_BOX(gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12));
+  GtkBox *labels = GTK_BOX(gtk_box_new(GTK_ORIENTATION_VERTICAL, 2));
+  GtkWidget *title = gtk_label_new(NULL);
+  GtkWidget *subtitle = gtk_label_new(NULL);
+
+  gtk_widget_set_hexpand(GTK_WIDGET(labels), TRUE);
+  gtk_widget_set_valign(GTK_WIDGET(labels), GTK_ALIGN_CENTER);
+  gtk_label_set_xalign(GTK_LABEL(title), 0);
+  gtk_label_set_ellipsize(GTK_LABEL(title), PANGO_ELLIPSIZE_END);
+  gtk_label_set_xalign(GTK_LABEL(subtitle), 0);
+  gtk_widget_add_css_class(subtitle, "dim-label");
+  gtk_widget_add_css_class(subtitle, "caption");
+
+  gtk_box_append(labels, title);
+  gtk_box_append(labels, subtitle);
+  gtk_box_append(box, GTK_WIDGET(labels));
+  gtk_box_append(box, gtk_image_new());
+  gtk_box_append(box, gtk_image_new_from_icon_name("go-next"));
+
+  gtk_list_item_set_child(list_item, GTK_WIDGET(box));
+}
+
+static void
+wifi_row_bind(GtkSignalListItemFactory *factory, GtkListItem *list_item, gpointer user_data)
+{
+  WifiNetwork *network = gtk_list_item_get_item(list_item);
+  GtkWidget *labels = gtk_widget_get_first_child(gtk_list_item_get_child(list_item));
+
+  gtk_label_set_label(GTK_LABEL(gtk_widget_get_first_child(labels)), wifi_network_get_title(network));
+  wifi_row_update(network, NULL, list_item);
+
+  /* Only bound rows listen, so the cost doesn't grow with the scan */
+  g_signal_connect(network, "notify", G_CALLBACK(wifi_row_update), list_item);
 }
 
-static void add_ap(gpointer ap_ptr, NetworkSettingsInterface *iface)
+static void
+wifi_row_unbind(GtkSignalListItemFactory *factory, GtkListItem *list_item, gpointer user_data)
 {
-  NMAccessPoint *ap = NM_ACCESS_POINT(ap_ptr);
+  g_signal_handlers_disconnect_by_func(gtk_list_item_get_item(list_item), wifi_row_update, list_item);
+}
 
+static void
+add_ap(NMAccessPoint *ap, NetworkSettingsInterface *iface, GPtrArray *new_networks)
+{
+  WifiNetwork *network;
   GBytes *ssid;
-  struct dup_data dup_data = {NULL, NULL, NULL};
+  char *hash;
+
+  if (g_hash_table_contains(iface->wifi->ap_networks, ap))
+    return;
 
   /* Don't add BSSs that hide their SSID or are denylisted */
   ssid = nm_access_point_get_ssid(ap);
   if (!ssid || nm_utils_is_empty_ssid(g_bytes_get_data(ssid, NULL), g_bytes_get_size(ssid)) || is_denylisted_ssid(ssid))
     return;
 
-  /* Find out if this AP is a member of a larger network that all uses the
-   * same SSID and security settings.  If so, we'll already have a menu item
-   * for this SSID, so just update that item's strength and add this AP to
-   * menu item's duplicate list.
-   */
-  dup_data.found = NULL;
-  dup_data.hash = g_object_get_data(G_OBJECT(ap), "hash");
-  g_return_if_fail(dup_data.hash != NULL);
+  /* If this AP is one more BSSID of a network we already show, add it to
+   * that network instead of making a new one */
+  hash = wifi_network_hash_access_point(ap);
+  network = g_hash_table_lookup(iface->wifi->networks, hash);
 
-  dup_data.iface = iface;
-  g_list_foreach(iface->aps_args, find_duplicate, &dup_data);
-
-  if (dup_data.found)
+  if (network)
   {
-    // nm_network_menu_item_set_strength (dup_data.found, nm_access_point_get_strength (ap), applet);
-    // nm_network_menu_item_add_dupe (dup_data.found, ap);
+    g_free(hash);
+  }
+  else
+  {
+    network = wifi_network_new(ap, hash);
+    wifi_network_set_known(network, network_client_has_connection_for_ssid(wifi_network_get_ssid(network)));
+    g_hash_table_insert(iface->wifi->networks, (char *)wifi_network_get_hash(network), network);
+    g_ptr_array_add(new_networks, network);
+  }
+
+  wifi_network_add_access_point(network, ap);
+  g_hash_table_insert(iface->wifi->ap_networks, ap, network);
+}
+
+static void drop_network(WifiNetwork *network, NetworkSettingsInterface *iface, GHashTable *dead_networks);
+
+static void
+remove_ap(NMAccessPoint *ap, NetworkSettingsInterface *iface, GHashTable *dead_networks)
+{
+  WifiNetwork *network = g_hash_table_lookup(iface->wifi->ap_networks, ap);
+
+  /* Hidden and denylisted APs were never added */
+  if (!network)
     return;
+
+  g_hash_table_remove(iface->wifi->ap_networks, ap);
+
+  if (!wifi_network_remove_access_point(network, ap))
+    drop_network(network, iface, dead_networks);
+}
+
+/* Takes the network out of every table. It stays in the list model, and
+ * alive through dead_networks, until the next splice. */
+static void
+drop_network(WifiNetwork *network, NetworkSettingsInterface *iface, GHashTable *dead_networks)
+{
+  g_signal_handlers_disconnect_by_data(network, iface);
+  g_hash_table_remove(iface->wifi->pending_resort, network);
+  if (iface->wifi->connected_network == network)
+    iface->wifi->connected_network = NULL;
+
+  /* Keep it alive until it is out of the list model */
+  g_hash_table_add(dead_networks, g_object_ref(network));
+  g_hash_table_remove(iface->wifi->networks, wifi_network_get_hash(network));
+}
+
+/* Applies every queued AP change at once, so the list is updated once
+ * per burst however many BSSIDs came and went */
+static void
+apply_ap_changes(NetworkSettingsInterface *iface)
+{
+  GHashTable *dead_networks = g_hash_table_new_full(NULL, NULL, g_object_unref, NULL);
+  GPtrArray *new_networks = g_ptr_array_new();
+  GListModel *model = G_LIST_MODEL(iface->wifi->store);
+  guint n_items = g_list_model_get_n_items(model);
+  guint n_dead, run_start = 0, run_end = 0;
+  GHashTableIter iter;
+  gpointer ap;
+
+  /* Removals first, so a network that lost its last BSSID and regained
+   * one in the same burst is rebuilt rather than looked up half-dead */
+  g_hash_table_iter_init(&iter, iface->wifi->pending_removed);
+  while (g_hash_table_iter_next(&iter, &ap, NULL))
+  {
+    remove_ap(ap, iface, dead_networks);
+    wifi_channel_view_remove_access_point(iface->wifi->channels, ap);
   }
+  g_hash_table_remove_all(iface->wifi->pending_removed);
 
-  AdwActionRow *row = ADW_ACTION_ROW(adw_action_row_new());
-  GBytes *ssid_bytes = nm_access_point_get_ssid(ap);
-  char *ssid_str = nm_utils_ssid_to_utf8(g_bytes_get_data(ssid_bytes, NULL), g_bytes_get_size(ssid_bytes));
-  adw_preferences_row_set_title(ADW_PREFERENCES_ROW(row), ssid_str);
-  free(ssid_str);
-  gtk_list_box_row_set_activatable(GTK_LIST_BOX_ROW(row), TRUE);
-  adw_action_row_add_suffix(ADW_ACTION_ROW(row), GTK_WIDGET(gtk_image_new_from_icon_name("go-next")));
+  g_hash_table_iter_init(&iter, iface->wifi->pending_added);
+  while (g_hash_table_iter_next(&iter, &ap, NULL))
+  {
+    add_ap(ap, iface, new_networks);
+    wifi_channel_view_add_access_point(iface->wifi->channels, ap);
+  }
+  g_hash_table_remove_all(iface->wifi->pending_added);
+
+  if (iface->wifi->prune_cached_networks)
+  {
+    gpointer network;
+
+    g_hash_table_iter_init(&iter, iface->wifi->networks);
+    while (g_hash_table_iter_next(&iter, NULL, &network))
+    {
+      if (wifi_network_get_stale(network))
+      {
+        /* Steal the table's reference so drop_network() doesn't remove
+         * from the table being walked */
+        g_hash_table_iter_steal(&iter);
+        drop_network(network, iface, dead_networks);
+        g_object_unref(network);
+      }
+    }
 
-  WifiArgs *args = malloc(sizeof(WifiArgs));
-  args->ap = ap;
-  args->iface = iface;
-  args->row = row;
-  args->hash = strdup(dup_data.hash);
-  g_signal_connect(row, "activated", G_CALLBACK(on_wifi_activated), args);
+    iface->wifi->prune_cached_networks = FALSE;
+    iface->wifi->has_cached_networks = FALSE;
+  }
+
+  /* The active AP may have only just been added */
+  update_connected_network(iface);
+
+  /* New networks go straight to their place; changes to the ones already
+   * listed are picked up by on_network_notify() from here on */
+  for (guint i = 0; i < new_networks->len; i++)
+  {
+    wifi_network_commit_sort_key(new_networks->pdata[i]);
+    g_signal_connect(new_networks->pdata[i], "notify", G_CALLBACK(on_network_notify), iface);
+  }
+
+  /* The sorter above the store decides the order, so the store's own
+   * doesn't matter. Take each run of dead networks out where it is,
+   * walking back so the positions still to visit hold, and append the
+   * new ones in one go; the sort model then only places what came or
+   * went, and the survivors' rows stay bound. */
+  n_dead = g_hash_table_size(dead_networks);
+  for (guint i = n_items; i > 0 && n_dead > 0; i--)
+  {
+    WifiNetwork *network = g_list_model_get_item(model, i - 1);
+    gboolean dead = g_hash_table_contains(dead_networks, network);
+
+    g_object_unref(network);
+
+    if (dead)
+    {
+      if (!run_end)
+        run_end = i;
+      run_start = i - 1;
+      n_dead--;
+    }
+    else if (run_end)
+    {
+      g_list_store_splice(iface->wifi->store, run_start, run_end - run_start, NULL, 0);
+      run_end = 0;
+    }
+  }
 
-  iface->aps_args = g_list_append(iface->aps_args, args);
+  if (run_end)
+    g_list_store_splice(iface->wifi->store, run_start, run_end - run_start, NULL, 0);
 
-  adw_preferences_group_add(iface->wifi_group, GTK_WIDGET(row));
+  if (new_networks->len > 0)
+    g_list_store_splice(iface->wifi->store, g_list_model_get_n_items(model), 0, new_networks->pdata, new_networks->len);
+
+  g_ptr_array_unref(new_networks);
+  g_hash_table_unref(dead_networks);
+}
+
+static gboolean
+on_ap_flush_timeout(NetworkSettingsInterface *iface)
+{
+  gint64 start = g_get_monotonic_time();
+
+  iface->wifi->flush_source = 0;
+  apply_ap_changes(iface);
+
+  settings_profiler_sample("wifi:ap-batch", start);
+  settings_profiler_sample("wifi:ap-latency", iface->wifi->pending_since);
+
+  return G_SOURCE_REMOVE;
 }
 
-static void remove_ap_gtk(AdwActionRow *row)
+static void
+queue_ap_flush(NetworkSettingsInterface *iface)
 {
-  gtk_list_box_remove(GTK_LIST_BOX(gtk_widget_get_parent(GTK_WIDGET(row))), GTK_WIDGET(row));
+  if (iface->wifi->flush_source)
+    return;
+
+  iface->wifi->pending_since = g_get_monotonic_time();
+  iface->wifi->flush_source = g_timeout_add(AP_FLUSH_DELAY_MS, (GSourceFunc)on_ap_flush_timeout, iface);
 }
 
 static void on_ap_add(NMDeviceWifi *device, NMAccessPoint *ap, NetworkSettingsInterface *iface)
 {
-  printf("test\n\n");
-  fflush(stdout);
-  add_ap(ap, iface);
+  /* Gone and back before the list saw either change */
+  if (g_hash_table_remove(iface->wifi->pending_removed, ap))
+    return;
+
+  g_hash_table_add(iface->wifi->pending_added, g_object_ref(ap));
+  iface->wifi->scan_results_changed = TRUE;
+  queue_ap_flush(iface);
 }
 
 static void on_ap_remove(NMDeviceWifi *device, NMAccessPoint *ap, NetworkSettingsInterface *iface)
 {
-  printf("test22\n\n");
-  fflush(stdout);
-  GList *item = iface->aps_args;
-  while (item)
+  /* Never shown, so there is nothing to take away */
+  if (g_hash_table_remove(iface->wifi->pending_added, ap))
+    return;
+
+  g_hash_table_add(iface->wifi->pending_removed, g_object_ref(ap));
+  iface->wifi->scan_results_changed = TRUE;
+  queue_ap_flush(iface);
+}
+
+static void
+on_last_scan_changed(NMDeviceWifi *device, GParamSpec *pspec, NetworkSettingsInterface *iface)
+{
+  if (!iface->wifi->has_cached_networks)
+    return;
+
+  /* In the same batch as the scan's AP changes, so a cached network that
+   * is still around is merged before the rest are dropped */
+  iface->wifi->prune_cached_networks = TRUE;
+  queue_ap_flush(iface);
+}
+
+/* Lists the networks from the scan cache as stale until a scan says
+ * otherwise. Live APs are merged into them by hash as they come. */
+static void
+load_cached_networks(NetworkSettingsInterface *iface)
+{
+  GPtrArray *cached = wifi_scan_cache_load(NM_DEVICE_WIFI(iface->device));
+  GPtrArray *added = g_ptr_array_new();
+
+  for (guint i = 0; i < cached->len; i++)
   {
-    WifiArgs *args = (WifiArgs *)item->data;
+    WifiNetwork *network = cached->pdata[i];
 
-    if (args->ap == ap)
-    {
-      iface->aps_args = g_list_remove(iface->aps_args, args);
+    if (g_hash_table_contains(iface->wifi->networks, wifi_network_get_hash(network)))
+      continue;
 
-      g_idle_add(G_SOURCE_FUNC(remove_ap_gtk), args->row);
+    wifi_network_set_known(network, network_client_has_connection_for_ssid(wifi_network_get_ssid(network)));
+    wifi_network_commit_sort_key(network);
+    g_signal_connect(network, "notify", G_CALLBACK(on_network_notify), iface);
 
-      free(args);
-      break;
-    }
+    g_hash_table_insert(iface->wifi->networks, (char *)wifi_network_get_hash(network), g_object_ref(network));
+    g_ptr_array_add(added, network);
+  }
+
+  g_list_store_splice(iface->wifi->store, 0, 0, added->pdata, added->len);
+  iface->wifi->has_cached_networks = added->len > 0;
+
+  g_ptr_array_unref(added);
+  g_ptr_array_unref(cached);
+}
 
-    item = item->next;
+static void
+get_scan_interval_bounds(NetworkSettingsInterface *iface, guint *min, guint *max)
+{
+  if (g_power_profile_monitor_get_power_saver_enabled(iface->self->power_monitor))
+  {
+    *min = SCAN_INTERVAL_POWER_SAVER_MIN_S;
+    *max = SCAN_INTERVAL_POWER_SAVER_MAX_S;
+  }
+  else
+  {
+    *min = SCAN_INTERVAL_MIN_S;
+    *max = SCAN_INTERVAL_MAX_S;
   }
 }
 
-static GtkWidget *create_net_interface(NMDevice *device, NetworkSettingsWindow *self)
+static void
+on_scan_requested(GObject *source_object, GAsyncResult *result, gpointer user_data)
 {
-  const char *description = nm_device_get_description(device);
-  const char *name = nm_device_get_iface(device);
+  GError *error = NULL;
 
-  NetworkSettingsInterface *iface = malloc(sizeof(NetworkSettingsInterface));
+  /* NM refuses while a scan is already running or the radio is off, and
+   * the next interval tries again, so there is nothing to report */
+  if (!nm_device_wifi_request_scan_finish(NM_DEVICE_WIFI(source_object), result, &error))
+    g_error_free(error);
+}
 
-  iface->self = self;
-  iface->iface_row = NULL;
-  iface->iface_page = NULL;
-  iface->device = NULL;
-  iface->device_type = NM_DEVICE_TYPE_UNKNOWN;
-  iface->title = NULL;
-  iface->self = NULL;
-  iface->aps_args = NULL;
+/* NM's own background scans and other clients count too */
+static gboolean
+has_recent_scan(NetworkSettingsInterface *iface)
+{
+  gint64 last_scan = nm_device_wifi_get_last_scan(NM_DEVICE_WIFI(iface->device));
 
-  iface->device = device;
-  iface->self = self;
+  return last_scan >= 0 && nm_utils_get_timestamp_msec() - last_scan < SCAN_MAX_AGE_MS;
+}
 
-  size_t title_len = strlen(description) + strlen(name) + strlen(" ()") + 1;
-  iface->title = malloc(title_len);
-  snprintf(iface->title, title_len, "%s (%s)", description, name);
+static void
+request_scan_if_stale(NetworkSettingsInterface *iface)
+{
+  if (has_recent_scan(iface))
+    return;
 
-  iface->device_type = nm_device_get_device_type(device);
+  nm_device_wifi_request_scan_async(NM_DEVICE_WIFI(iface->device), iface->wifi->scan_cancellable, on_scan_requested, NULL);
+}
+
+static gboolean
+on_scan_timeout(NetworkSettingsInterface *iface)
+{
+  guint min, max;
+
+  get_scan_interval_bounds(iface, &min, &max);
+
+  if (iface->wifi->scan_results_changed)
+    iface->wifi->scan_interval = min;
+  else
+    iface->wifi->scan_interval = CLAMP(iface->wifi->scan_interval * 2, min, max);
+  iface->wifi->scan_results_changed = FALSE;
+
+  request_scan_if_stale(iface);
+  iface->wifi->scan_source = g_timeout_add_seconds(iface->wifi->scan_interval, (GSourceFunc)on_scan_timeout, iface);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+on_wifi_page_map(GtkWidget *page, NetworkSettingsInterface *iface)
+{
+  guint max;
+
+  stop_scanning(iface);
+
+  get_scan_interval_bounds(iface, &iface->wifi->scan_interval, &max);
+  iface->wifi->scan_results_changed = FALSE;
+  iface->wifi->scan_cancellable = g_cancellable_new();
+
+  request_scan_if_stale(iface);
+  iface->wifi->scan_source = g_timeout_add_seconds(iface->wifi->scan_interval, (GSourceFunc)on_scan_timeout, iface);
+}
+
+static void
+stop_scanning(NetworkSettingsInterface *iface)
+{
+  if (!iface->wifi)
+    return;
+
+  g_clear_handle_id(&iface->wifi->scan_source, g_source_remove);
+
+  if (iface->wifi->scan_cancellable)
+    g_cancellable_cancel(iface->wifi->scan_cancellable);
+  g_clear_object(&iface->wifi->scan_cancellable);
+}
+
+static void
+on_wifi_page_unmap(GtkWidget *page, NetworkSettingsInterface *iface)
+{
+  stop_scanning(iface);
+}
+
+static void
+update_timing_label(NetworkSettingsInterface *iface)
+{
+  NMActiveConnection *active = nm_device_get_active_connection(iface->device);
+  char *text = active ? connection_timing_describe(nm_active_connection_get_uuid(active)) : NULL;
 
+  gtk_label_set_label(iface->timing_label, text);
+  gtk_widget_set_visible(GTK_WIDGET(iface->timing_label), text != NULL);
+
+  g_free(text);
+}
+
+static void
+on_device_active_connection_changed(NMDevice *device, GParamSpec *pspec, NetworkSettingsInterface *iface)
+{
+  update_timing_label(iface);
+}
+
+static void
+on_device_state_changed(NMDevice *device, guint new_state, guint old_state, guint reason, NetworkSettingsInterface *iface)
+{
+  update_timing_label(iface);
+}
+
+/* Traffic graph and the last activation's timing, for the top of an
+ * interface page. The graph samples the IP interface, which differs
+ * from the device's for PPP and the like. */
+static GtkWidget *
+create_page_header(NetworkSettingsInterface *iface)
+{
+  const char *ip_iface = nm_device_get_ip_iface(iface->device);
+  GtkWidget *graph = network_stats_graph_new(ip_iface ? ip_iface : nm_device_get_iface(iface->device));
+  GtkBox *box = GTK_BOX(gtk_box_new(GTK_ORIENTATION_VERTICAL, 6));
+  GtkWidget *clamp = adw_clamp_new();
+
+  iface->timing_label = GTK_LABEL(gtk_label_new(NULL));
+  gtk_label_set_xalign(iface->timing_label, 0);
+  gtk_widget_add_css_class(GTK_WIDGET(iface->timing_label), "dim-label");
+  gtk_widget_add_css_class(GTK_WIDGET(iface->timing_label), "caption");
+
+  gtk_box_append(box, graph);
+  gtk_box_append(box, GTK_WIDGET(iface->timing_label));
+  gtk_widget_set_margin_top(GTK_WIDGET(box), 12);
+  gtk_widget_set_margin_start(GTK_WIDGET(box), 12);
+  gtk_widget_set_margin_end(GTK_WIDGET(box), 12);
+  adw_clamp_set_child(ADW_CLAMP(clamp), GTK_WIDGET(box));
+
+  update_timing_label(iface);
+  g_signal_connect(iface->device, "notify::" NM_DEVICE_ACTIVE_CONNECTION, G_CALLBACK(on_device_active_connection_changed), iface);
+  /* After, so an activation that just finished has been recorded */
+  g_signal_connect_after(iface->device, "state-changed", G_CALLBACK(on_device_state_changed), iface);
+
+  return clamp;
+}
+
+/* Builds the page shown when the interface's row is activated. Until
+ * then a Wi-Fi interface has no builder, no network model and no AP
+ * signal handlers. */
+static void
+build_interface_page(NetworkSettingsInterface *iface)
+{
   switch (iface->device_type)
   {
   case NM_DEVICE_TYPE_WIFI:
-    /* code */
-    iface->wifi_builder = gtk_builder_new_from_resource("/com/plenjos/Settings/network/wifi-settings-window.ui");
+    iface->wifi = g_new0(NetworkSettingsWifiPage, 1);
+    iface->wifi->builder = gtk_builder_new_from_resource("/com/plenjos/Settings/network/wifi-settings-window.ui");
+
+    iface->iface_page = ADW_NAVIGATION_PAGE(gtk_builder_get_object(iface->wifi->builder, "nav_page"));
+    iface->wifi->list = GTK_LIST_VIEW(gtk_builder_get_object(iface->wifi->builder, "networks_list"));
+
+    GtkWidget *header = create_page_header(iface);
+    iface->wifi->channels = WIFI_CHANNEL_VIEW(wifi_channel_view_new());
+    gtk_box_append(GTK_BOX(adw_clamp_get_child(ADW_CLAMP(header))), GTK_WIDGET(iface->wifi->channels));
+    gtk_box_insert_child_after(GTK_BOX(gtk_builder_get_object(iface->wifi->builder, "wifi_settings_box")),
+                               header,
+                               GTK_WIDGET(gtk_builder_get_object(iface->wifi->builder, "wifi_settings_header_bar")));
+
+    GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+    g_signal_connect(factory, "setup", G_CALLBACK(wifi_row_setup), NULL);
+    g_signal_connect(factory, "bind", G_CALLBACK(wifi_row_bind), NULL);
+    g_signal_connect(factory, "unbind", G_CALLBACK(wifi_row_unbind), NULL);
+
+    iface->wifi->store = g_list_store_new(WIFI_TYPE_NETWORK);
+    GtkSorter *sorter = GTK_SORTER(gtk_custom_sorter_new(wifi_network_compare, NULL, NULL));
+    GtkSortListModel *sorted = gtk_sort_list_model_new(G_LIST_MODEL(g_object_ref(iface->wifi->store)), sorter);
+    GtkNoSelection *selection = gtk_no_selection_new(G_LIST_MODEL(sorted));
+
+    /* The list view takes ownership of both */
+    gtk_list_view_set_factory(iface->wifi->list, factory);
+    gtk_list_view_set_model(iface->wifi->list, GTK_SELECTION_MODEL(selection));
+    g_object_unref(factory);
+    g_object_unref(selection);
+
+    g_signal_connect(iface->wifi->list, "activate", G_CALLBACK(on_wifi_activated), iface);
 
-    iface->iface_page = ADW_NAVIGATION_PAGE(gtk_builder_get_object(iface->wifi_builder, "nav_page"));
-    iface->wifi_group = ADW_PREFERENCES_GROUP(gtk_builder_get_object(iface->wifi_builder, "networks_group"));
+    iface->wifi->networks = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_object_unref);
+    iface->wifi->ap_networks = g_hash_table_new(NULL, NULL);
+    iface->wifi->pending_added = g_hash_table_new_full(NULL, NULL, g_object_unref, NULL);
+    iface->wifi->pending_removed = g_hash_table_new_full(NULL, NULL, g_object_unref, NULL);
+    iface->wifi->pending_resort = g_hash_table_new_full(NULL, NULL, g_object_unref, NULL);
 
-    nm_device_wifi_request_scan(NM_DEVICE_WIFI(device), NULL, NULL);
+    g_signal_connect(iface->iface_page, "map", G_CALLBACK(on_wifi_page_map), iface);
+    g_signal_connect(iface->iface_page, "unmap", G_CALLBACK(on_wifi_page_unmap), iface);
 
-    iface->aps = nm_device_wifi_get_access_points(NM_DEVICE_WIFI(device));
+    iface->wifi->aps = nm_device_wifi_get_access_points(NM_DEVICE_WIFI(iface->device));
 
-    g_ptr_array_foreach(iface->aps, (GFunc)add_ap, iface);
+    if (!has_recent_scan(iface))
+      load_cached_networks(iface);
+
+    /* The initial population goes through the same path, in one splice */
+    gint64 start = g_get_monotonic_time();
+    for (guint i = 0; i < iface->wifi->aps->len; i++)
+      g_hash_table_add(iface->wifi->pending_added, g_object_ref(iface->wifi->aps->pdata[i]));
+    apply_ap_changes(iface);
+    settings_profiler_sample("wifi:populate", start);
+    settings_profiler_sample("wifi:time-to-populate", settings_profiler_get_start_time());
+
+    wifi_channel_view_set_active_access_point(iface->wifi->channels, nm_device_wifi_get_active_access_point(NM_DEVICE_WIFI(iface->device)));
 
     g_signal_connect(iface->device, "access_point_added", G_CALLBACK(on_ap_add), iface);
     g_signal_connect(iface->device, "access_point_removed", G_CALLBACK(on_ap_remove), iface);
-    // NMConnection *connection = NM_CONNECTION (nm_client_get_primary_connection (self->nm_client));
+    g_signal_connect(iface->device, "notify::" NM_DEVICE_WIFI_ACTIVE_ACCESS_POINT, G_CALLBACK(on_active_access_point_changed), iface);
+    g_signal_connect(iface->device, "notify::" NM_DEVICE_WIFI_LAST_SCAN, G_CALLBACK(on_last_scan_changed), iface);
     break;
   default:
     GtkBox *navpage_box = GTK_BOX(gtk_box_new(GTK_ORIENTATION_VERTICAL, 0));
     AdwHeaderBar *header_bar = ADW_HEADER_BAR(adw_header_bar_new());
     adw_header_bar_set_show_back_button(header_bar, TRUE);
     gtk_box_append(navpage_box, GTK_WIDGET(header_bar));
+    gtk_box_append(navpage_box, create_page_header(iface));
+
+    /* veth and dummy take the same ethtool calls, which makes them handy
+     * for trying this out */
+    if (iface->device_type == NM_DEVICE_TYPE_ETHERNET || iface->device_type == NM_DEVICE_TYPE_VETH || iface->device_type == NM_DEVICE_TYPE_DUMMY)
+      gtk_box_append(navpage_box, wired_link_view_new(iface->device));
 
     iface->iface_page = adw_navigation_page_new(GTK_WIDGET(navpage_box), iface->title);
 
     break;
   }
+}
+
+static void on_iface_activated(AdwActionRow *row, NetworkSettingsInterface *iface)
+{
+  if (iface->iface_page && adw_navigation_view_get_visible_page(iface->self->interfaces_view) == iface->iface_page)
+    return;
+
+  if (!iface->iface_page)
+    build_interface_page(iface);
+
+  adw_navigation_view_push(iface->self->interfaces_view, iface->iface_page);
+}
 
-  adw_navigation_view_add(self->interfaces_view, iface->iface_page);
+static NetworkSettingsInterface *create_net_interface(NMDevice *device, NetworkSettingsWindow *self)
+{
+  const char *description = nm_device_get_description(device);
+  const char *name = nm_device_get_iface(device);
+
+  NetworkSettingsInterface *iface = g_new0(NetworkSettingsInterface, 1);
+
+  iface->device = device;
+  iface->self = self;
+  iface->title = g_strdup_printf("%s (%s)", description, name);
+
+  iface->device_type = nm_device_get_device_type(device);
 
   iface->iface_row = ADW_PREFERENCES_ROW(adw_action_row_new());
   adw_preferences_row_set_title(iface->iface_row, iface->title);
@@ -616,32 +1266,271 @@ static GtkWidget *create_net_interface(NMDevice *device, NetworkSettingsWindow *
   adw_action_row_add_suffix(ADW_ACTION_ROW(iface->iface_row), GTK_WIDGET(gtk_image_new_from_icon_name("go-next")));
   g_signal_connect(iface->iface_row, "activated", G_CALLBACK(on_iface_activated), iface);
 
-  return GTK_WIDGET(iface->iface_row);
+  return iface;
+}
+
+/* veth pairs, bridges and tun devices that container runtimes and VPNs
+ * create by the dozen, and that NetworkManager leaves alone */
+static gboolean
+is_virtual_device_hidden(NMDevice *device)
+{
+  return !nm_device_get_managed(device) && (nm_device_is_software(device) || !nm_device_is_real(device));
 }
 
 static void
-network_settings_window_init(NetworkSettingsWindow *self)
+update_virtual_devices_row(NetworkSettingsWindow *self)
 {
-  gtk_widget_init_template(GTK_WIDGET(self));
+  char *subtitle = g_strdup_printf("%u hidden", self->n_virtual_devices);
 
-  GtkCssProvider *cssProvider = gtk_css_provider_new();
-  gtk_css_provider_load_from_resource(cssProvider, "/com/plenjos/Settings/theme.css");
-  gtk_style_context_add_provider_for_display(gdk_display_get_default(),
-                                             GTK_STYLE_PROVIDER(cssProvider),
-                                             GTK_STYLE_PROVIDER_PRIORITY_USER);
+  adw_action_row_set_subtitle(self->virtual_devices_row, subtitle);
+  gtk_widget_set_visible(GTK_WIDGET(self->virtual_devices_group), self->n_virtual_devices > 0);
 
-  self->nm_client = nm_client_new(NULL, NULL);
+  g_free(subtitle);
+}
 
-  if (self->nm_client)
-    g_print("NetworkManager version: %s\n", nm_client_get_version(self->nm_client));
+static void
+remove_interface_widgets(NetworkSettingsWindow *self, NetworkSettingsInterface *iface)
+{
+  /* Pushed pages aren't added to the view, so popping lets go of it */
+  if (iface->iface_page && adw_navigation_view_get_visible_page(self->interfaces_view) == iface->iface_page)
+    adw_navigation_view_pop(self->interfaces_view);
+
+  adw_preferences_group_remove(self->interfaces_group, GTK_WIDGET(iface->iface_row));
+}
+
+/* Shows or hides the row of one device. Nothing else is rebuilt, so a
+ * churning device costs one row at most. */
+static void
+update_device(NetworkSettingsWindow *self, NMDevice *device)
+{
+  NetworkSettingsInterface *iface = NULL;
+  gboolean tracked = g_hash_table_lookup_extended(self->devices, device, NULL, (gpointer *)&iface);
+  gboolean hidden = is_virtual_device_hidden(device);
+
+  if (tracked && hidden == (iface == NULL))
+    return;
+
+  if (iface)
+  {
+    remove_interface_widgets(self, iface);
+    g_hash_table_insert(self->devices, g_object_ref(device), NULL);
+  }
+  else if (tracked)
+  {
+    self->n_virtual_devices--;
+  }
+
+  if (hidden)
+  {
+    g_hash_table_insert(self->devices, g_object_ref(device), NULL);
+    self->n_virtual_devices++;
+  }
+  else
+  {
+    iface = create_net_interface(device, self);
+    g_hash_table_insert(self->devices, g_object_ref(device), iface);
+    adw_preferences_group_add(self->interfaces_group, GTK_WIDGET(iface->iface_row));
+
+    /* Asked for by network_settings_window_show_device() before it was here */
+    if (self->pending_device && !g_strcmp0(self->pending_device, nm_device_get_iface(device)))
+    {
+      g_clear_pointer(&self->pending_device, g_free);
+      on_iface_activated(ADW_ACTION_ROW(iface->iface_row), iface);
+    }
+  }
+
+  update_virtual_devices_row(self);
+}
+
+static void
+on_page_popped(AdwNavigationView *view, AdwNavigationPage *page, NetworkSettingsWindow *self)
+{
+  GHashTableIter iter;
+  NetworkSettingsInterface *iface;
+
+  if (page == self->saved_networks_page)
+  {
+    self->saved_networks_page = NULL;
+    return;
+  }
+
+  if (!self->devices)
+    return;
+
+  g_hash_table_iter_init(&iter, self->devices);
+  while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&iface))
+  {
+    if (iface && iface->iface_page == page)
+    {
+      destroy_interface_page(iface);
+      return;
+    }
+  }
+}
+
+static void
+on_device_changed(NMDevice *device, GParamSpec *pspec, NetworkSettingsWindow *self)
+{
+  update_device(self, device);
+}
+
+static void
+on_device_added(NMClient *client, NMDevice *device, NetworkSettingsWindow *self)
+{
+  if (g_hash_table_contains(self->devices, device))
+    return;
+
+  g_signal_connect(device, "notify::" NM_DEVICE_MANAGED, G_CALLBACK(on_device_changed), self);
+  g_signal_connect(device, "notify::" NM_DEVICE_REAL, G_CALLBACK(on_device_changed), self);
+
+  update_device(self, device);
+}
+
+static void
+on_device_removed(NMClient *client, NMDevice *device, NetworkSettingsWindow *self)
+{
+  NetworkSettingsInterface *iface;
+
+  if (!g_hash_table_lookup_extended(self->devices, device, NULL, (gpointer *)&iface))
+    return;
+
+  g_signal_handlers_disconnect_by_data(device, self);
+
+  if (iface)
+    remove_interface_widgets(self, iface);
+  else
+    self->n_virtual_devices--;
+
+  g_hash_table_remove(self->devices, device);
+  update_virtual_devices_row(self);
+}
+
+/* The shared client has already updated its index by the time a page
+ * hears about a saved connection coming or going */
+static void
+update_known_networks(NetworkSettingsWindow *self)
+{
+  GHashTableIter device_iter;
+  NetworkSettingsInterface *iface;
+
+  g_hash_table_iter_init(&device_iter, self->devices);
+  while (g_hash_table_iter_next(&device_iter, NULL, (gpointer *)&iface))
+  {
+    GHashTableIter iter;
+    gpointer network;
+
+    if (!iface || !iface->wifi)
+      continue;
+
+    g_hash_table_iter_init(&iter, iface->wifi->networks);
+    while (g_hash_table_iter_next(&iter, NULL, &network))
+      wifi_network_set_known(network, network_client_has_connection_for_ssid(wifi_network_get_ssid(network)));
+  }
+}
+
+static void
+on_connections_changed(NMClient *client, NMRemoteConnection *connection, NetworkSettingsWindow *self)
+{
+  update_known_networks(self);
+}
+
+static void
+on_saved_networks_activated(AdwActionRow *row, NetworkSettingsWindow *self)
+{
+  if (!self->saved_networks_page)
+    self->saved_networks_page = saved_networks_page_new(self->nm_client);
+
+  adw_navigation_view_push(self->interfaces_view, self->saved_networks_page);
+}
+
+static void
+on_nm_client_ready(GObject *source_object, GAsyncResult *result, NetworkSettingsWindow *self)
+{
+  GError *error = NULL;
+  NMClient *client = network_client_get_finish(result, &error);
+
+  if (!client)
+  {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      fprintf(stderr, "Failed to connect to NetworkManager. %s.\n", error->message);
+      fflush(stderr);
+
+      adw_preferences_row_set_title(ADW_PREFERENCES_ROW(self->loading_row), "NetworkManager is not available");
+      adw_action_row_set_subtitle(self->loading_row, error->message);
+      gtk_widget_set_visible(self->loading_spinner, FALSE);
+    }
+
+    g_error_free(error);
+    return;
+  }
+
+  self->nm_client = client;
+
+  adw_preferences_group_remove(self->interfaces_group, GTK_WIDGET(self->loading_row));
+  self->loading_row = NULL;
+  self->loading_spinner = NULL;
+
+  g_signal_connect(self->nm_client, NM_CLIENT_CONNECTION_ADDED, G_CALLBACK(on_connections_changed), self);
+  g_signal_connect(self->nm_client, NM_CLIENT_CONNECTION_REMOVED, G_CALLBACK(on_connections_changed), self);
 
   const GPtrArray *devices = nm_client_get_devices(self->nm_client);
 
   for (size_t i = 0; i < devices->len; i++)
-  {
-    printf("Device: %s\n", nm_device_get_iface(NM_DEVICE(devices->pdata[i])));
+    on_device_added(self->nm_client, NM_DEVICE(devices->pdata[i]), self);
+
+  g_signal_connect(self->nm_client, NM_CLIENT_DEVICE_ADDED, G_CALLBACK(on_device_added), self);
+  g_signal_connect(self->nm_client, NM_CLIENT_DEVICE_REMOVED, G_CALLBACK(on_device_removed), self);
+
+  g_signal_connect(self->saved_networks_row, "activated", G_CALLBACK(on_saved_networks_activated), self);
+  gtk_widget_set_visible(GTK_WIDGET(self->saved_networks_group), TRUE);
+}
+
+static void
+network_settings_window_init(NetworkSettingsWindow *self)
+{
+  gtk_widget_init_template(GTK_WIDGET(self));
+
+  /* theme.css is already loaded for the display by the settings window.
+   * Loading it again here added another provider every time this page
+   * was rebuilt after being evicted. */
 
-    adw_preferences_group_add(self->interfaces_group, create_net_interface(NM_DEVICE(devices->pdata[i]), self));
+  self->loading_row = ADW_ACTION_ROW(adw_action_row_new());
+  adw_preferences_row_set_title(ADW_PREFERENCES_ROW(self->loading_row), "Connecting to NetworkManager…");
+  self->loading_spinner = adw_spinner_new();
+  adw_action_row_add_suffix(self->loading_row, self->loading_spinner);
+  adw_preferences_group_add(self->interfaces_group, GTK_WIDGET(self->loading_row));
+
+  g_signal_connect(self->interfaces_view, "popped", G_CALLBACK(on_page_popped), self);
+
+  self->devices = g_hash_table_new_full(NULL, NULL, g_object_unref, (GDestroyNotify)network_settings_interface_free);
+  self->power_monitor = g_power_profile_monitor_dup_default();
+
+  self->cancellable = g_cancellable_new();
+  network_client_get_async(self->cancellable, (GAsyncReadyCallback)on_nm_client_ready, self);
+}
+
+void network_settings_window_show_device(NetworkSettingsWindow *self, const char *name)
+{
+  GHashTableIter iter;
+  gpointer device;
+  NetworkSettingsInterface *iface;
+
+  g_return_if_fail(NETWORK_SETTINGS_IS_WINDOW(self));
+  g_return_if_fail(name != NULL);
+
+  g_clear_pointer(&self->pending_device, g_free);
+
+  g_hash_table_iter_init(&iter, self->devices);
+  while (g_hash_table_iter_next(&iter, &device, (gpointer *)&iface))
+  {
+    if (iface && !g_strcmp0(nm_device_get_iface(device), name))
+    {
+      on_iface_activated(ADW_ACTION_ROW(iface->iface_row), iface);
+      return;
+    }
   }
-  fflush(stdout);
+
+  /* The client may not be ready yet, or the device not plugged in */
+  self->pending_device = g_strdup(name);
 }
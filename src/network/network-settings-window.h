@@ -34,4 +34,8 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE(NetworkSettingsWindow, network_settings_window, NETWORK_SETTINGS, WINDOW, AdwNavigationPage)
 
+/* Opens the page of the device with the interface name, now or as soon
+ * as NetworkManager reports it */
+void network_settings_window_show_device(NetworkSettingsWindow *self, const char *name);
+
 G_END_DECLS
@@ -0,0 +1,381 @@
+/* network-stats-graph.c
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "settings-config.h"
+#include "network-stats-graph.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Two minutes at one sample a second */
+#define N_SAMPLES 120
+#define SAMPLE_INTERVAL_S 1
+
+typedef enum
+{
+  STAT_RX_BYTES,
+  STAT_TX_BYTES,
+  STAT_RX_PACKETS,
+  STAT_TX_PACKETS,
+  STAT_RX_DROPPED,
+  STAT_TX_DROPPED,
+  STAT_RX_ERRORS,
+  STAT_TX_ERRORS,
+  N_STATS
+} Stat;
+
+static const char *stat_names[N_STATS] = {
+    "rx_bytes",
+    "tx_bytes",
+    "rx_packets",
+    "tx_packets",
+    "rx_dropped",
+    "tx_dropped",
+    "rx_errors",
+    "tx_errors",
+};
+
+/* Rates per second over one interval */
+typedef struct Sample
+{
+  double rx_bytes;
+  double tx_bytes;
+  double packets;
+  double drops;
+  double errors;
+} Sample;
+
+struct _NetworkStatsGraph
+{
+  GtkWidget parent_instance;
+
+  char *iface;
+
+  /* Kept open while mapped and re-read with pread() */
+  int fds[N_STATS];
+  guint64 counters[N_STATS];
+  gint64 counters_time;
+  gboolean have_counters;
+
+  /* Ring buffer; samples[head] is the next slot to be written */
+  Sample samples[N_SAMPLES];
+  guint head;
+  guint n_samples;
+
+  guint sample_source;
+};
+
+G_DEFINE_TYPE(NetworkStatsGraph, network_stats_graph, GTK_TYPE_WIDGET)
+
+static gboolean
+read_counter(int fd, guint64 *value)
+{
+  char buf[32];
+  ssize_t len = pread(fd, buf, sizeof(buf) - 1, 0);
+
+  if (len <= 0)
+    return FALSE;
+
+  buf[len] = '\0';
+  *value = g_ascii_strtoull(buf, NULL, 10);
+
+  return TRUE;
+}
+
+static void
+close_counters(NetworkStatsGraph *self)
+{
+  for (int i = 0; i < N_STATS; i++)
+  {
+    if (self->fds[i] >= 0)
+      close(self->fds[i]);
+    self->fds[i] = -1;
+  }
+
+  self->have_counters = FALSE;
+}
+
+static gboolean
+open_counters(NetworkStatsGraph *self)
+{
+  char path[128];
+
+  for (int i = 0; i < N_STATS; i++)
+  {
+    g_snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/%s", self->iface, stat_names[i]);
+    self->fds[i] = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (self->fds[i] < 0)
+    {
+      close_counters(self);
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/* Counters that went backwards were reset, e.g. by a driver reload */
+static double
+rate(guint64 now, guint64 before, double seconds)
+{
+  return now >= before ? (now - before) / seconds : 0;
+}
+
+static gboolean
+take_sample(NetworkStatsGraph *self)
+{
+  guint64 counters[N_STATS];
+  gint64 now = g_get_monotonic_time();
+  double seconds;
+  Sample *sample;
+
+  for (int i = 0; i < N_STATS; i++)
+  {
+    /* The interface went away under us */
+    if (!read_counter(self->fds[i], &counters[i]))
+    {
+      self->sample_source = 0;
+      close_counters(self);
+      gtk_widget_queue_draw(GTK_WIDGET(self));
+      return G_SOURCE_REMOVE;
+    }
+  }
+
+  if (self->have_counters)
+  {
+    seconds = MAX(now - self->counters_time, 1) / (double)G_USEC_PER_SEC;
+    sample = &self->samples[self->head];
+
+    sample->rx_bytes = rate(counters[STAT_RX_BYTES], self->counters[STAT_RX_BYTES], seconds);
+    sample->tx_bytes = rate(counters[STAT_TX_BYTES], self->counters[STAT_TX_BYTES], seconds);
+    sample->packets = rate(counters[STAT_RX_PACKETS], self->counters[STAT_RX_PACKETS], seconds) +
+                      rate(counters[STAT_TX_PACKETS], self->counters[STAT_TX_PACKETS], seconds);
+    sample->drops = rate(counters[STAT_RX_DROPPED], self->counters[STAT_RX_DROPPED], seconds) +
+                    rate(counters[STAT_TX_DROPPED], self->counters[STAT_TX_DROPPED], seconds);
+    sample->errors = rate(counters[STAT_RX_ERRORS], self->counters[STAT_RX_ERRORS], seconds) +
+                     rate(counters[STAT_TX_ERRORS], self->counters[STAT_TX_ERRORS], seconds);
+
+    self->head = (self->head + 1) % N_SAMPLES;
+    self->n_samples = MIN(self->n_samples + 1, N_SAMPLES);
+
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+  }
+
+  memcpy(self->counters, counters, sizeof(counters));
+  self->counters_time = now;
+  self->have_counters = TRUE;
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* i counts from the oldest sample */
+static const Sample *
+get_sample(NetworkStatsGraph *self, guint i)
+{
+  return &self->samples[(self->head + N_SAMPLES - self->n_samples + i) % N_SAMPLES];
+}
+
+static void
+network_stats_graph_map(GtkWidget *widget)
+{
+  NetworkStatsGraph *self = NETWORK_STATS_GRAPH(widget);
+
+  GTK_WIDGET_CLASS(network_stats_graph_parent_class)->map(widget);
+
+  if (!self->iface || !open_counters(self))
+    return;
+
+  /* The gap while hidden isn't a real interval, so start a new graph */
+  self->n_samples = 0;
+  if (take_sample(self))
+    self->sample_source = g_timeout_add_seconds(SAMPLE_INTERVAL_S, (GSourceFunc)take_sample, self);
+}
+
+static void
+network_stats_graph_unmap(GtkWidget *widget)
+{
+  NetworkStatsGraph *self = NETWORK_STATS_GRAPH(widget);
+
+  g_clear_handle_id(&self->sample_source, g_source_remove);
+  close_counters(self);
+
+  GTK_WIDGET_CLASS(network_stats_graph_parent_class)->unmap(widget);
+}
+
+static void
+network_stats_graph_measure(GtkWidget *widget,
+                            GtkOrientation orientation,
+                            int for_size,
+                            int *minimum,
+                            int *natural,
+                            int *minimum_baseline,
+                            int *natural_baseline)
+{
+  if (orientation == GTK_ORIENTATION_HORIZONTAL)
+  {
+    *minimum = 200;
+    *natural = 400;
+  }
+  else
+  {
+    *minimum = 120;
+    *natural = 160;
+  }
+}
+
+static void
+append_series(NetworkStatsGraph *self, GtkSnapshot *snapshot, gboolean tx, const GdkRGBA *color, const graphene_rect_t *area, double max)
+{
+  GskPathBuilder *builder;
+  GskStroke *stroke;
+  GskPath *path;
+
+  if (self->n_samples < 2)
+    return;
+
+  builder = gsk_path_builder_new();
+
+  for (guint i = 0; i < self->n_samples; i++)
+  {
+    const Sample *sample = get_sample(self, i);
+    double value = tx ? sample->tx_bytes : sample->rx_bytes;
+
+    /* Newest sample on the right edge */
+    float x = area->origin.x + area->size.width * (N_SAMPLES - self->n_samples + i) / (N_SAMPLES - 1);
+    float y = area->origin.y + area->size.height * (1 - value / max);
+
+    if (i == 0)
+      gsk_path_builder_move_to(builder, x, y);
+    else
+      gsk_path_builder_line_to(builder, x, y);
+  }
+
+  path = gsk_path_builder_free_to_path(builder);
+  stroke = gsk_stroke_new(1.5);
+  gtk_snapshot_append_stroke(snapshot, path, stroke, color);
+
+  gsk_stroke_free(stroke);
+  gsk_path_unref(path);
+}
+
+static void
+network_stats_graph_snapshot(GtkWidget *widget, GtkSnapshot *snapshot)
+{
+  NetworkStatsGraph *self = NETWORK_STATS_GRAPH(widget);
+  static const GdkRGBA rx_color = {0.21, 0.52, 0.89, 1.0};
+  static const GdkRGBA tx_color = {0.90, 0.38, 0.00, 1.0};
+  int width = gtk_widget_get_width(widget);
+  int height = gtk_widget_get_height(widget);
+  GdkRGBA grid_color;
+  PangoLayout *layout;
+  graphene_rect_t area;
+  int text_height;
+  double max = 1024;
+  char *text;
+
+  if (self->n_samples > 0)
+  {
+    const Sample *last = get_sample(self, self->n_samples - 1);
+    char *rx = g_format_size((guint64)last->rx_bytes);
+    char *tx = g_format_size((guint64)last->tx_bytes);
+
+    text = g_strdup_printf("↓ %s/s   ↑ %s/s   %.0f packets/s   %.0f drops/s   %.0f errors/s",
+                           rx, tx, last->packets, last->drops, last->errors);
+    g_free(rx);
+    g_free(tx);
+  }
+  else
+  {
+    text = g_strdup(self->sample_source || self->have_counters ? "Measuring…" : "Statistics are not available");
+  }
+
+  layout = gtk_widget_create_pango_layout(widget, text);
+  pango_layout_set_width(layout, width * PANGO_SCALE);
+  pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
+  pango_layout_get_pixel_size(layout, NULL, &text_height);
+  gtk_widget_get_color(widget, &grid_color);
+  gtk_snapshot_append_layout(snapshot, layout, &grid_color);
+  g_object_unref(layout);
+  g_free(text);
+
+  /* Scale to the busiest second on screen */
+  for (guint i = 0; i < self->n_samples; i++)
+  {
+    const Sample *sample = get_sample(self, i);
+    max = MAX(max, MAX(sample->rx_bytes, sample->tx_bytes));
+  }
+
+  area = GRAPHENE_RECT_INIT(0, text_height + 6, width, MAX(height - text_height - 6, 1));
+
+  grid_color.alpha *= 0.15;
+  gtk_snapshot_append_color(snapshot, &grid_color, &GRAPHENE_RECT_INIT(0, area.origin.y + area.size.height - 1, width, 1));
+
+  append_series(self, snapshot, FALSE, &rx_color, &area, max);
+  append_series(self, snapshot, TRUE, &tx_color, &area, max);
+}
+
+static void
+network_stats_graph_finalize(GObject *object)
+{
+  NetworkStatsGraph *self = NETWORK_STATS_GRAPH(object);
+
+  g_clear_handle_id(&self->sample_source, g_source_remove);
+  close_counters(self);
+  g_free(self->iface);
+
+  G_OBJECT_CLASS(network_stats_graph_parent_class)->finalize(object);
+}
+
+static void
+network_stats_graph_class_init(NetworkStatsGraphClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+
+  object_class->finalize = network_stats_graph_finalize;
+
+  widget_class->map = network_stats_graph_map;
+  widget_class->unmap = network_stats_graph_unmap;
+  widget_class->measure = network_stats_graph_measure;
+  widget_class->snapshot = network_stats_graph_snapshot;
+
+  gtk_widget_class_set_css_name(widget_class, "network-stats-graph");
+}
+
+static void
+network_stats_graph_init(NetworkStatsGraph *self)
+{
+  gtk_widget_set_overflow(GTK_WIDGET(self), GTK_OVERFLOW_HIDDEN);
+
+  for (int i = 0; i < N_STATS; i++)
+    self->fds[i] = -1;
+}
+
+GtkWidget *network_stats_graph_new(const char *iface)
+{
+  NetworkStatsGraph *self = g_object_new(NETWORK_TYPE_STATS_GRAPH, NULL);
+
+  /* Anything else would escape /sys/class/net */
+  if (iface && *iface && !strchr(iface, '/') && strcmp(iface, ".") && strcmp(iface, ".."))
+    self->iface = g_strdup(iface);
+
+  return GTK_WIDGET(self);
+}
@@ -0,0 +1,35 @@
+/* network-stats-graph.h
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/* Live RX/TX throughput of one network interface, read from
+ * /sys/class/net/<iface>/statistics, with packet, drop and error rates
+ * printed above the graph. It only samples while it is mapped.
+ */
+#define NETWORK_TYPE_STATS_GRAPH (network_stats_graph_get_type())
+
+G_DECLARE_FINAL_TYPE(NetworkStatsGraph, network_stats_graph, NETWORK, STATS_GRAPH, GtkWidget)
+
+GtkWidget *network_stats_graph_new(const char *iface);
+
+G_END_DECLS
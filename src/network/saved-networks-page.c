@@ -0,0 +1,429 @@
+/* saved-networks-page.c
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "settings-config.h"
+#include "saved-networks-page.h"
+
+#include <stdio.h>
+
+/* Profiles not used for this long are offered for removal */
+#define OLD_PROFILE_AGE_DAYS 90
+
+/* Names listed in the confirmation before the rest are summed up */
+#define MAX_LISTED_NAMES 5
+
+struct _SavedNetworksPage
+{
+  AdwNavigationPage parent_instance;
+
+  NMClient *client;
+
+  /* NMRemoteConnection, Wi-Fi only, in no particular order */
+  GListStore *store;
+  GtkFilter *filter;
+
+  /* Casefolded search text */
+  char *search;
+};
+
+G_DEFINE_TYPE(SavedNetworksPage, saved_networks_page, ADW_TYPE_NAVIGATION_PAGE)
+
+typedef struct DeleteBatch
+{
+  guint pending;
+  guint failed;
+} DeleteBatch;
+
+static gboolean
+is_wifi_connection(NMRemoteConnection *connection)
+{
+  return nm_connection_is_type(NM_CONNECTION(connection), NM_SETTING_WIRELESS_SETTING_NAME);
+}
+
+static guint64
+get_timestamp(NMRemoteConnection *connection)
+{
+  NMSettingConnection *s_con = nm_connection_get_setting_connection(NM_CONNECTION(connection));
+
+  return s_con ? nm_setting_connection_get_timestamp(s_con) : 0;
+}
+
+static const char *
+get_name(NMRemoteConnection *connection)
+{
+  const char *id = nm_connection_get_id(NM_CONNECTION(connection));
+
+  return id ? id : "";
+}
+
+static gboolean
+is_old(NMRemoteConnection *connection, guint64 now)
+{
+  guint64 timestamp = get_timestamp(connection);
+
+  /* Never used may just mean never in range yet, so those stay */
+  return timestamp > 0 && now - MIN(timestamp, now) > OLD_PROFILE_AGE_DAYS * 24 * 60 * 60;
+}
+
+static gboolean
+filter_connection(gpointer item, gpointer user_data)
+{
+  SavedNetworksPage *self = user_data;
+  char *name;
+  gboolean match;
+
+  if (!self->search || !*self->search)
+    return TRUE;
+
+  name = g_utf8_casefold(get_name(item), -1);
+  match = strstr(name, self->search) != NULL;
+  g_free(name);
+
+  return match;
+}
+
+/* Most recently used first */
+static int
+compare_connections(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  guint64 timestamp_a = get_timestamp(NM_REMOTE_CONNECTION((gpointer)a));
+  guint64 timestamp_b = get_timestamp(NM_REMOTE_CONNECTION((gpointer)b));
+
+  if (timestamp_a != timestamp_b)
+    return timestamp_a > timestamp_b ? -1 : 1;
+
+  return g_utf8_collate(get_name(NM_REMOTE_CONNECTION((gpointer)a)), get_name(NM_REMOTE_CONNECTION((gpointer)b)));
+}
+
+static void
+on_search_changed(GtkSearchEntry *entry, SavedNetworksPage *self)
+{
+  char *search = g_utf8_casefold(gtk_editable_get_text(GTK_EDITABLE(entry)), -1);
+  const char *old = self->search ? self->search : "";
+  GtkFilterChange change;
+
+  /* Typing on only narrows the matches, and deleting only widens them,
+   * so the filter model doesn't have to look at every profile again */
+  if (strstr(search, old))
+    change = GTK_FILTER_CHANGE_MORE_STRICT;
+  else if (strstr(old, search))
+    change = GTK_FILTER_CHANGE_LESS_STRICT;
+  else
+    change = GTK_FILTER_CHANGE_DIFFERENT;
+
+  g_free(self->search);
+  self->search = search;
+
+  gtk_filter_changed(self->filter, change);
+}
+
+/* The name or last use changed: replace the profile by itself, so the
+ * sort and filter models look at it again, and only at it */
+static void
+on_connection_changed(NMRemoteConnection *connection, SavedNetworksPage *self)
+{
+  guint position;
+
+  if (g_list_store_find(self->store, connection, &position))
+    g_list_store_splice(self->store, position, 1, (gpointer *)&connection, 1);
+}
+
+static void
+add_connection(SavedNetworksPage *self, NMRemoteConnection *connection)
+{
+  if (!is_wifi_connection(connection))
+    return;
+
+  g_list_store_append(self->store, connection);
+  g_signal_connect(connection, "changed", G_CALLBACK(on_connection_changed), self);
+}
+
+static void
+on_connection_added(NMClient *client, NMRemoteConnection *connection, SavedNetworksPage *self)
+{
+  add_connection(self, connection);
+}
+
+static void
+on_connection_removed(NMClient *client, NMRemoteConnection *connection, SavedNetworksPage *self)
+{
+  guint position;
+
+  if (!g_list_store_find(self->store, connection, &position))
+    return;
+
+  g_signal_handlers_disconnect_by_data(connection, self);
+  g_list_store_remove(self->store, position);
+}
+
+static void
+on_deleted(GObject *connection, GAsyncResult *result, gpointer user_data)
+{
+  DeleteBatch *batch = user_data;
+  GError *error = NULL;
+
+  if (!nm_remote_connection_delete_finish(NM_REMOTE_CONNECTION(connection), result, &error))
+  {
+    fprintf(stderr, "Failed to remove %s. %s.\n", get_name(NM_REMOTE_CONNECTION(connection)), error->message);
+    fflush(stderr);
+    g_error_free(error);
+    batch->failed++;
+  }
+
+  if (--batch->pending > 0)
+    return;
+
+  if (batch->failed > 0)
+  {
+    fprintf(stderr, "%u saved networks could not be removed.\n", batch->failed);
+    fflush(stderr);
+  }
+
+  g_free(batch);
+}
+
+/* NM has no call for removing several profiles, so they are all sent
+ * at once and counted back in. The list follows connection-removed. */
+static void
+delete_connections(GPtrArray *connections)
+{
+  DeleteBatch *batch = g_new0(DeleteBatch, 1);
+
+  batch->pending = connections->len;
+
+  for (guint i = 0; i < connections->len; i++)
+    nm_remote_connection_delete_async(connections->pdata[i], NULL, on_deleted, batch);
+}
+
+static void
+on_remove_old_response(AdwAlertDialog *dialog, const char *response, GPtrArray *connections)
+{
+  if (!g_strcmp0(response, "remove") && connections->len > 0)
+    delete_connections(connections);
+}
+
+static void
+on_remove_old_clicked(GtkButton *button, SavedNetworksPage *self)
+{
+  GListModel *model = G_LIST_MODEL(self->store);
+  guint64 now = g_get_real_time() / G_USEC_PER_SEC;
+  GPtrArray *old = g_ptr_array_new_with_free_func(g_object_unref);
+  GString *names = g_string_new(NULL);
+  AdwDialog *dialog;
+
+  for (guint i = 0; i < g_list_model_get_n_items(model); i++)
+  {
+    NMRemoteConnection *connection = g_list_model_get_item(model, i);
+
+    if (is_old(connection, now))
+    {
+      if (old->len < MAX_LISTED_NAMES)
+        g_string_append_printf(names, "%s%s", old->len ? ", " : "", get_name(connection));
+      g_ptr_array_add(old, g_object_ref(connection));
+    }
+
+    g_object_unref(connection);
+  }
+
+  if (old->len == 0)
+  {
+    dialog = adw_alert_dialog_new("No Old Networks", NULL);
+    adw_alert_dialog_format_body(ADW_ALERT_DIALOG(dialog), "Every saved network has been used in the last %d days.", OLD_PROFILE_AGE_DAYS);
+    adw_alert_dialog_add_response(ADW_ALERT_DIALOG(dialog), "close", "Close");
+  }
+  else
+  {
+    if (old->len > MAX_LISTED_NAMES)
+      g_string_append_printf(names, " and %u more", old->len - MAX_LISTED_NAMES);
+
+    dialog = adw_alert_dialog_new(NULL, NULL);
+    adw_alert_dialog_format_heading(ADW_ALERT_DIALOG(dialog), "Remove %u Old Networks?", old->len);
+    adw_alert_dialog_format_body(ADW_ALERT_DIALOG(dialog), "These haven't been used in %d days: %s.", OLD_PROFILE_AGE_DAYS, names->str);
+    adw_alert_dialog_add_responses(ADW_ALERT_DIALOG(dialog), "cancel", "Cancel", "remove", "Remove", NULL);
+    adw_alert_dialog_set_response_appearance(ADW_ALERT_DIALOG(dialog), "remove", ADW_RESPONSE_DESTRUCTIVE);
+    adw_alert_dialog_set_default_response(ADW_ALERT_DIALOG(dialog), "cancel");
+  }
+
+  /* The dialog owns the list from here */
+  g_signal_connect_data(dialog, "response", G_CALLBACK(on_remove_old_response), old, (GClosureNotify)g_ptr_array_unref, 0);
+  adw_dialog_present(dialog, GTK_WIDGET(self));
+
+  g_string_free(names, TRUE);
+}
+
+static void
+row_setup(GtkSignalListItemFactory *factory, GtkListItem *list_item, gpointer user_data)
+{
+  GtkBox *labels = GTK_BOX(gtk_box_new(GTK_ORIENTATION_VERTICAL, 2));
+  GtkWidget *title = gtk_label_new(NULL);
+  GtkWidget *subtitle = gtk_label_new(NULL);
+
+  gtk_widget_set_valign(GTK_WIDGET(labels), GTK_ALIGN_CENTER);
+  gtk_label_set_xalign(GTK_LABEL(title), 0);
+  gtk_label_set_ellipsize(GTK_LABEL(title), PANGO_ELLIPSIZE_END);
+  gtk_label_set_xalign(GTK_LABEL(subtitle), 0);
+  gtk_widget_add_css_class(subtitle, "dim-label");
+  gtk_widget_add_css_class(subtitle, "caption");
+
+  gtk_box_append(labels, title);
+  gtk_box_append(labels, subtitle);
+
+  gtk_list_item_set_child(list_item, GTK_WIDGET(labels));
+  gtk_list_item_set_activatable(list_item, FALSE);
+}
+
+static void
+row_bind(GtkSignalListItemFactory *factory, GtkListItem *list_item, gpointer user_data)
+{
+  NMRemoteConnection *connection = gtk_list_item_get_item(list_item);
+  GtkWidget *title = gtk_widget_get_first_child(gtk_list_item_get_child(list_item));
+  GtkWidget *subtitle = gtk_widget_get_next_sibling(title);
+  guint64 timestamp = get_timestamp(connection);
+  guint64 now = g_get_real_time() / G_USEC_PER_SEC;
+  guint64 days = now > timestamp ? (now - timestamp) / (24 * 60 * 60) : 0;
+  char *text;
+
+  gtk_label_set_label(GTK_LABEL(title), get_name(connection));
+
+  if (timestamp == 0)
+    text = g_strdup("Never used");
+  else if (days == 0)
+    text = g_strdup("Last used today");
+  else if (days == 1)
+    text = g_strdup("Last used yesterday");
+  else
+    text = g_strdup_printf("Last used %" G_GUINT64_FORMAT " days ago", days);
+
+  gtk_label_set_label(GTK_LABEL(subtitle), text);
+  g_free(text);
+}
+
+static void
+saved_networks_page_dispose(GObject *object)
+{
+  SavedNetworksPage *self = SAVED_NETWORKS_PAGE(object);
+
+  if (self->store)
+  {
+    GListModel *model = G_LIST_MODEL(self->store);
+
+    for (guint i = 0; i < g_list_model_get_n_items(model); i++)
+    {
+      NMRemoteConnection *connection = g_list_model_get_item(model, i);
+      g_signal_handlers_disconnect_by_data(connection, self);
+      g_object_unref(connection);
+    }
+  }
+
+  if (self->client)
+    g_signal_handlers_disconnect_by_data(self->client, self);
+
+  g_clear_object(&self->client);
+  g_clear_object(&self->store);
+  g_clear_object(&self->filter);
+  g_clear_pointer(&self->search, g_free);
+
+  G_OBJECT_CLASS(saved_networks_page_parent_class)->dispose(object);
+}
+
+static void
+saved_networks_page_class_init(SavedNetworksPageClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+  object_class->dispose = saved_networks_page_dispose;
+}
+
+static void
+saved_networks_page_init(SavedNetworksPage *self)
+{
+  GtkBox *box = GTK_BOX(gtk_box_new(GTK_ORIENTATION_VERTICAL, 0));
+  AdwHeaderBar *header_bar = ADW_HEADER_BAR(adw_header_bar_new());
+  GtkWidget *remove_old = gtk_button_new_with_label("Remove Old…");
+  GtkWidget *search_entry = gtk_search_entry_new();
+  GtkWidget *search_clamp = adw_clamp_new();
+  GtkWidget *scrolled_window = gtk_scrolled_window_new();
+  GtkWidget *clamp = adw_clamp_scrollable_new();
+  GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+  GtkSortListModel *sorted;
+  GtkFilterListModel *filtered;
+  GtkWidget *list;
+
+  adw_navigation_page_set_title(ADW_NAVIGATION_PAGE(self), "Saved Networks");
+
+  gtk_widget_set_tooltip_text(remove_old, "Remove networks not used in a long time");
+  adw_header_bar_pack_end(header_bar, remove_old);
+  g_signal_connect(remove_old, "clicked", G_CALLBACK(on_remove_old_clicked), self);
+
+  gtk_search_entry_set_placeholder_text(GTK_SEARCH_ENTRY(search_entry), "Search saved networks");
+  gtk_widget_set_margin_top(search_entry, 12);
+  gtk_widget_set_margin_start(search_entry, 12);
+  gtk_widget_set_margin_end(search_entry, 12);
+  g_signal_connect(search_entry, "search-changed", G_CALLBACK(on_search_changed), self);
+
+  g_signal_connect(factory, "setup", G_CALLBACK(row_setup), NULL);
+  g_signal_connect(factory, "bind", G_CALLBACK(row_bind), NULL);
+
+  self->store = g_list_store_new(NM_TYPE_REMOTE_CONNECTION);
+  self->filter = GTK_FILTER(gtk_custom_filter_new(filter_connection, self, NULL));
+
+  /* Sorted underneath the filter, so narrowing the search never sorts */
+  sorted = gtk_sort_list_model_new(G_LIST_MODEL(g_object_ref(self->store)),
+                                   GTK_SORTER(gtk_custom_sorter_new(compare_connections, NULL, NULL)));
+  filtered = gtk_filter_list_model_new(G_LIST_MODEL(sorted), g_object_ref(self->filter));
+  gtk_filter_list_model_set_incremental(filtered, TRUE);
+
+  list = gtk_list_view_new(GTK_SELECTION_MODEL(gtk_no_selection_new(G_LIST_MODEL(filtered))), factory);
+  gtk_widget_set_name(list, "saved_networks_list");
+  gtk_widget_set_valign(list, GTK_ALIGN_START);
+  gtk_widget_add_css_class(list, "card");
+
+  gtk_widget_set_margin_top(clamp, 12);
+  gtk_widget_set_margin_bottom(clamp, 24);
+  gtk_widget_set_margin_start(clamp, 12);
+  gtk_widget_set_margin_end(clamp, 12);
+  adw_clamp_scrollable_set_child(ADW_CLAMP_SCROLLABLE(clamp), list);
+
+  gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+  gtk_widget_set_vexpand(scrolled_window, TRUE);
+  gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled_window), clamp);
+
+  adw_clamp_set_child(ADW_CLAMP(search_clamp), search_entry);
+
+  gtk_box_append(box, GTK_WIDGET(header_bar));
+  gtk_box_append(box, search_clamp);
+  gtk_box_append(box, scrolled_window);
+
+  adw_navigation_page_set_child(ADW_NAVIGATION_PAGE(self), GTK_WIDGET(box));
+}
+
+AdwNavigationPage *saved_networks_page_new(NMClient *client)
+{
+  SavedNetworksPage *self = g_object_new(SAVED_TYPE_NETWORKS_PAGE, NULL);
+  const GPtrArray *connections = nm_client_get_connections(client);
+
+  self->client = g_object_ref(client);
+
+  for (guint i = 0; i < connections->len; i++)
+    add_connection(self, connections->pdata[i]);
+
+  g_signal_connect(client, NM_CLIENT_CONNECTION_ADDED, G_CALLBACK(on_connection_added), self);
+  g_signal_connect(client, NM_CLIENT_CONNECTION_REMOVED, G_CALLBACK(on_connection_removed), self);
+
+  return ADW_NAVIGATION_PAGE(self);
+}
@@ -0,0 +1,38 @@
+/* saved-networks-page.h
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+#include <adwaita.h>
+
+#include <NetworkManager.h>
+
+G_BEGIN_DECLS
+
+/* Every saved Wi-Fi profile, most recently used first, with a search
+ * that filters as you type and a way to remove the ones that haven't
+ * been used in a long time.
+ */
+#define SAVED_TYPE_NETWORKS_PAGE (saved_networks_page_get_type())
+
+G_DECLARE_FINAL_TYPE(SavedNetworksPage, saved_networks_page, SAVED, NETWORKS_PAGE, AdwNavigationPage)
+
+AdwNavigationPage *saved_networks_page_new(NMClient *client);
+
+G_END_DECLS
@@ -0,0 +1,513 @@
+/* wifi-channel-view.c
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "settings-config.h"
+#include "wifi-channel-view.h"
+
+typedef enum
+{
+  BAND_2GHZ,
+  BAND_5GHZ,
+  BAND_6GHZ,
+  N_BANDS
+} Band;
+
+static const char *band_names[N_BANDS] = {"2.4 GHz", "5 GHz", "6 GHz"};
+
+/* Channel numbers fit in a byte in every band */
+#define N_CHANNELS 256
+
+/* 20 MHz wide 2.4 GHz channels are 5 MHz apart, so one reaches four
+ * channels either side, less the further away it is */
+#define OVERLAP_2GHZ 4
+
+/* Channels worth moving an AP to: the ones that don't overlap at
+ * 2.4 GHz, the non-DFS ones at 5 GHz and the preferred scanning
+ * channels at 6 GHz */
+static const guint8 candidates_2ghz[] = {1, 6, 11, 0};
+static const guint8 candidates_5ghz[] = {36, 40, 44, 48, 149, 153, 157, 161, 165, 0};
+static const guint8 candidates_6ghz[] = {5, 21, 37, 53, 69, 85, 101, 117, 133, 149, 165, 181, 197, 213, 229, 0};
+
+static const guint8 *candidates[N_BANDS] = {candidates_2ghz, candidates_5ghz, candidates_6ghz};
+
+/* Only suggest a channel with at most this share of the current load */
+#define SUGGEST_RATIO 0.5
+/* Below this a channel is quiet enough to leave alone */
+#define BUSY_LOAD 1.0
+#define CONGESTED_LOAD 3.0
+
+#define ROW_HEIGHT 56
+#define ROW_LABEL_WIDTH 64
+
+/* What one BSSID currently adds to its channel */
+typedef struct Contribution
+{
+  Band band;
+  guint8 channel;
+  double weight;
+} Contribution;
+
+struct _WifiChannelView
+{
+  GtkWidget parent_instance;
+
+  /* NMAccessPoint, referenced -> Contribution */
+  GHashTable *aps;
+
+  /* Strength-weighted BSSIDs per channel, before overlap */
+  double weights[N_BANDS][N_CHANNELS];
+  guint n_aps[N_BANDS];
+
+  NMAccessPoint *active_ap;
+};
+
+G_DEFINE_TYPE(WifiChannelView, wifi_channel_view, GTK_TYPE_WIDGET)
+
+static gboolean
+get_channel(guint32 frequency, Band *band, guint8 *channel)
+{
+  int number;
+
+  if (frequency >= 2412 && frequency <= 2484)
+  {
+    *band = BAND_2GHZ;
+    number = frequency == 2484 ? 14 : (frequency - 2407) / 5;
+  }
+  else if (frequency >= 5150 && frequency < 5925)
+  {
+    *band = BAND_5GHZ;
+    number = (frequency - 5000) / 5;
+  }
+  else if (frequency >= 5955 && frequency <= 7115)
+  {
+    *band = BAND_6GHZ;
+    number = (frequency - 5950) / 5;
+  }
+  else
+  {
+    return FALSE;
+  }
+
+  if (number <= 0 || number >= N_CHANNELS)
+    return FALSE;
+
+  *channel = number;
+
+  return TRUE;
+}
+
+static void
+contribute(WifiChannelView *self, Contribution *contribution, gboolean add)
+{
+  if (add)
+  {
+    self->weights[contribution->band][contribution->channel] += contribution->weight;
+    self->n_aps[contribution->band]++;
+  }
+  else
+  {
+    self->weights[contribution->band][contribution->channel] -= contribution->weight;
+    self->n_aps[contribution->band]--;
+  }
+
+  /* Rounding must not leave an empty channel slightly busy */
+  if (self->weights[contribution->band][contribution->channel] < 1e-6)
+    self->weights[contribution->band][contribution->channel] = 0;
+}
+
+/* Takes the AP's old share off its channel and puts the current one on */
+static void
+update_contribution(WifiChannelView *self, NMAccessPoint *ap, Contribution *contribution)
+{
+  guint n_bands = 0;
+
+  for (int i = 0; i < N_BANDS; i++)
+    n_bands += self->n_aps[i] > 0;
+
+  if (contribution->weight > 0)
+    contribute(self, contribution, FALSE);
+
+  if (get_channel(nm_access_point_get_frequency(ap), &contribution->band, &contribution->channel))
+  {
+    contribution->weight = MAX(nm_access_point_get_strength(ap), 1) / 100.0;
+    contribute(self, contribution, TRUE);
+  }
+  else
+  {
+    contribution->weight = 0;
+  }
+
+  /* A band row came or went */
+  for (int i = 0; i < N_BANDS; i++)
+    n_bands -= self->n_aps[i] > 0;
+  if (n_bands != 0)
+    gtk_widget_queue_resize(GTK_WIDGET(self));
+
+  gtk_widget_queue_draw(GTK_WIDGET(self));
+}
+
+static void
+on_ap_changed(NMAccessPoint *ap, GParamSpec *pspec, WifiChannelView *self)
+{
+  update_contribution(self, ap, g_hash_table_lookup(self->aps, ap));
+}
+
+void wifi_channel_view_add_access_point(WifiChannelView *self, NMAccessPoint *ap)
+{
+  Contribution *contribution;
+
+  g_return_if_fail(WIFI_IS_CHANNEL_VIEW(self));
+
+  if (g_hash_table_contains(self->aps, ap))
+    return;
+
+  contribution = g_new0(Contribution, 1);
+  g_hash_table_insert(self->aps, g_object_ref(ap), contribution);
+  update_contribution(self, ap, contribution);
+
+  g_signal_connect(ap, "notify::" NM_ACCESS_POINT_STRENGTH, G_CALLBACK(on_ap_changed), self);
+  g_signal_connect(ap, "notify::" NM_ACCESS_POINT_FREQUENCY, G_CALLBACK(on_ap_changed), self);
+}
+
+void wifi_channel_view_remove_access_point(WifiChannelView *self, NMAccessPoint *ap)
+{
+  Contribution *contribution;
+
+  g_return_if_fail(WIFI_IS_CHANNEL_VIEW(self));
+
+  contribution = g_hash_table_lookup(self->aps, ap);
+  if (!contribution)
+    return;
+
+  g_signal_handlers_disconnect_by_data(ap, self);
+
+  if (contribution->weight > 0)
+  {
+    contribute(self, contribution, FALSE);
+
+    if (self->n_aps[contribution->band] == 0)
+      gtk_widget_queue_resize(GTK_WIDGET(self));
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+  }
+
+  g_hash_table_remove(self->aps, ap);
+}
+
+void wifi_channel_view_set_active_access_point(WifiChannelView *self, NMAccessPoint *ap)
+{
+  g_return_if_fail(WIFI_IS_CHANNEL_VIEW(self));
+
+  if (g_set_object(&self->active_ap, ap))
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+}
+
+/* The load on a channel, counting what reaches it from its neighbours */
+static double
+get_load(WifiChannelView *self, Band band, int channel)
+{
+  double load = self->weights[band][channel];
+
+  if (band != BAND_2GHZ)
+    return load;
+
+  for (int distance = 1; distance <= OVERLAP_2GHZ; distance++)
+  {
+    double overlap = 1 - distance / (OVERLAP_2GHZ + 1.0);
+
+    if (channel - distance > 0)
+      load += overlap * self->weights[band][channel - distance];
+    if (channel + distance < N_CHANNELS)
+      load += overlap * self->weights[band][channel + distance];
+  }
+
+  return load;
+}
+
+static gboolean
+get_active_channel(WifiChannelView *self, Band *band, guint8 *channel, double *own_weight)
+{
+  Contribution *contribution = self->active_ap ? g_hash_table_lookup(self->aps, self->active_ap) : NULL;
+
+  if (!contribution || contribution->weight == 0)
+    return FALSE;
+
+  *band = contribution->band;
+  *channel = contribution->channel;
+  *own_weight = contribution->weight;
+
+  return TRUE;
+}
+
+/* Returns the quietest candidate channel in band if it is clearly
+ * quieter than the active one, or 0 */
+static guint8
+get_suggestion(WifiChannelView *self, Band band, guint8 channel, double load)
+{
+  guint8 best = 0;
+  double best_load = load * SUGGEST_RATIO;
+
+  if (load < BUSY_LOAD)
+    return 0;
+
+  for (const guint8 *candidate = candidates[band]; *candidate; candidate++)
+  {
+    double candidate_load = get_load(self, band, *candidate);
+
+    if (*candidate != channel && candidate_load < best_load)
+    {
+      best = *candidate;
+      best_load = candidate_load;
+    }
+  }
+
+  return best;
+}
+
+/* Channels drawn for band: all of them at 2.4 GHz, only the ones in use
+ * or highlighted above that */
+static gboolean
+is_channel_shown(WifiChannelView *self, Band band, int channel, guint8 active, guint8 suggested)
+{
+  if (band == BAND_2GHZ)
+    return channel <= 13 || self->weights[band][channel] > 0;
+
+  return self->weights[band][channel] > 0 || channel == active || channel == suggested;
+}
+
+static char *
+describe(WifiChannelView *self, gboolean has_active, Band band, guint8 channel, double load, guint8 suggested)
+{
+  const char *level;
+
+  if (!has_active)
+    return g_strdup_printf("%u BSSIDs on 2.4 GHz, %u on 5 GHz and %u on 6 GHz",
+                           self->n_aps[BAND_2GHZ], self->n_aps[BAND_5GHZ], self->n_aps[BAND_6GHZ]);
+
+  if (load >= CONGESTED_LOAD)
+    level = "congested";
+  else if (load >= BUSY_LOAD)
+    level = "busy";
+  else
+    level = "quiet";
+
+  if (suggested)
+    return g_strdup_printf("Channel %u (%s) is %s. Channel %u is quieter.", channel, band_names[band], level, suggested);
+
+  return g_strdup_printf("Channel %u (%s) is %s", channel, band_names[band], level);
+}
+
+static guint
+get_n_rows(WifiChannelView *self)
+{
+  guint n_rows = 0;
+
+  for (int band = 0; band < N_BANDS; band++)
+    n_rows += self->n_aps[band] > 0;
+
+  return n_rows;
+}
+
+static void
+wifi_channel_view_measure(GtkWidget *widget,
+                          GtkOrientation orientation,
+                          int for_size,
+                          int *minimum,
+                          int *natural,
+                          int *minimum_baseline,
+                          int *natural_baseline)
+{
+  WifiChannelView *self = WIFI_CHANNEL_VIEW(widget);
+
+  if (orientation == GTK_ORIENTATION_HORIZONTAL)
+  {
+    *minimum = 200;
+    *natural = 400;
+  }
+  else
+  {
+    PangoLayout *layout = gtk_widget_create_pango_layout(widget, "Ag");
+    int text_height;
+
+    pango_layout_get_pixel_size(layout, NULL, &text_height);
+    g_object_unref(layout);
+
+    *minimum = *natural = text_height + 6 + get_n_rows(self) * ROW_HEIGHT;
+  }
+}
+
+static void
+append_row(WifiChannelView *self, GtkSnapshot *snapshot, Band band, float y, float width, double max_load, guint8 active, guint8 suggested)
+{
+  static const GdkRGBA active_color = {0.21, 0.52, 0.89, 1.0};
+  static const GdkRGBA suggested_color = {0.18, 0.76, 0.49, 1.0};
+  GtkWidget *widget = GTK_WIDGET(self);
+  float bar_area = ROW_HEIGHT - 20;
+  GdkRGBA color, bar_color;
+  PangoLayout *layout;
+  guint n_shown = 0, i = 0;
+  float slot;
+
+  gtk_widget_get_color(widget, &color);
+  bar_color = color;
+  bar_color.alpha *= 0.35;
+
+  layout = gtk_widget_create_pango_layout(widget, band_names[band]);
+  gtk_snapshot_save(snapshot);
+  gtk_snapshot_translate(snapshot, &GRAPHENE_POINT_INIT(0, y + bar_area / 2 - 8));
+  gtk_snapshot_append_layout(snapshot, layout, &color);
+  gtk_snapshot_restore(snapshot);
+  g_object_unref(layout);
+
+  for (int channel = 1; channel < N_CHANNELS; channel++)
+    n_shown += is_channel_shown(self, band, channel, active, suggested);
+
+  if (n_shown == 0)
+    return;
+
+  slot = (width - ROW_LABEL_WIDTH) / n_shown;
+
+  for (int channel = 1; channel < N_CHANNELS; channel++)
+  {
+    float x, height;
+    char number[4];
+    int label_width;
+
+    if (!is_channel_shown(self, band, channel, active, suggested))
+      continue;
+
+    x = ROW_LABEL_WIDTH + i++ * slot;
+    height = MAX(bar_area * get_load(self, band, channel) / max_load, 1);
+
+    gtk_snapshot_append_color(snapshot,
+                              channel == active ? &active_color : channel == suggested ? &suggested_color : &bar_color,
+                              &GRAPHENE_RECT_INIT(x + 2, y + bar_area - height, MAX(slot - 4, 1), height));
+
+    g_snprintf(number, sizeof(number), "%d", channel);
+    layout = gtk_widget_create_pango_layout(widget, number);
+    pango_layout_get_pixel_size(layout, &label_width, NULL);
+    gtk_snapshot_save(snapshot);
+    gtk_snapshot_translate(snapshot, &GRAPHENE_POINT_INIT(x + (slot - label_width) / 2, y + bar_area + 2));
+    gtk_snapshot_append_layout(snapshot, layout, &color);
+    gtk_snapshot_restore(snapshot);
+    g_object_unref(layout);
+  }
+}
+
+static void
+wifi_channel_view_snapshot(GtkWidget *widget, GtkSnapshot *snapshot)
+{
+  WifiChannelView *self = WIFI_CHANNEL_VIEW(widget);
+  int width = gtk_widget_get_width(widget);
+  gboolean has_active;
+  Band active_band = BAND_2GHZ;
+  guint8 active = 0, suggested = 0;
+  double own_weight = 0, load = 0, max_load = 1;
+  PangoLayout *layout;
+  GdkRGBA color;
+  int text_height;
+  float y;
+  char *text;
+
+  has_active = get_active_channel(self, &active_band, &active, &own_weight);
+  if (has_active)
+  {
+    /* The connection itself doesn't crowd its own channel */
+    load = MAX(get_load(self, active_band, active) - own_weight, 0);
+    suggested = get_suggestion(self, active_band, active, load);
+  }
+
+  text = describe(self, has_active, active_band, active, load, suggested);
+  layout = gtk_widget_create_pango_layout(widget, text);
+  pango_layout_set_width(layout, width * PANGO_SCALE);
+  pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
+  pango_layout_get_pixel_size(layout, NULL, &text_height);
+  gtk_widget_get_color(widget, &color);
+  gtk_snapshot_append_layout(snapshot, layout, &color);
+  g_object_unref(layout);
+  g_free(text);
+
+  for (int band = 0; band < N_BANDS; band++)
+  {
+    for (int channel = 1; channel < N_CHANNELS; channel++)
+    {
+      if (self->weights[band][channel] > 0)
+        max_load = MAX(max_load, get_load(self, band, channel));
+    }
+  }
+
+  y = text_height + 6;
+
+  for (int band = 0; band < N_BANDS; band++)
+  {
+    if (self->n_aps[band] == 0)
+      continue;
+
+    append_row(self, snapshot, band, y, width,
+               max_load,
+               has_active && band == active_band ? active : 0,
+               has_active && band == active_band ? suggested : 0);
+    y += ROW_HEIGHT;
+  }
+}
+
+static void
+wifi_channel_view_dispose(GObject *object)
+{
+  WifiChannelView *self = WIFI_CHANNEL_VIEW(object);
+  GHashTableIter iter;
+  gpointer ap;
+
+  if (self->aps)
+  {
+    g_hash_table_iter_init(&iter, self->aps);
+    while (g_hash_table_iter_next(&iter, &ap, NULL))
+      g_signal_handlers_disconnect_by_data(ap, self);
+  }
+
+  g_clear_pointer(&self->aps, g_hash_table_unref);
+  g_clear_object(&self->active_ap);
+
+  G_OBJECT_CLASS(wifi_channel_view_parent_class)->dispose(object);
+}
+
+static void
+wifi_channel_view_class_init(WifiChannelViewClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+
+  object_class->dispose = wifi_channel_view_dispose;
+
+  widget_class->measure = wifi_channel_view_measure;
+  widget_class->snapshot = wifi_channel_view_snapshot;
+
+  gtk_widget_class_set_css_name(widget_class, "wifi-channel-view");
+}
+
+static void
+wifi_channel_view_init(WifiChannelView *self)
+{
+  self->aps = g_hash_table_new_full(NULL, NULL, g_object_unref, g_free);
+
+  gtk_widget_set_overflow(GTK_WIDGET(self), GTK_OVERFLOW_HIDDEN);
+}
+
+GtkWidget *wifi_channel_view_new(void)
+{
+  return g_object_new(WIFI_TYPE_CHANNEL_VIEW, NULL);
+}
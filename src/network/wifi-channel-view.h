@@ -0,0 +1,46 @@
+/* wifi-channel-view.h
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+#include <NetworkManager.h>
+
+G_BEGIN_DECLS
+
+/* How busy each Wi-Fi channel is, per band, from the BSSIDs in range.
+ * Every BSSID counts in proportion to its signal strength, and 2.4 GHz
+ * channels also count their overlapping neighbours. The channel of the
+ * active access point is highlighted, along with a quieter channel in
+ * the same band when there is a clearly better one.
+ *
+ * BSSIDs are added and removed one at a time and their strength is
+ * followed, so nothing is recounted over every access point.
+ */
+#define WIFI_TYPE_CHANNEL_VIEW (wifi_channel_view_get_type())
+
+G_DECLARE_FINAL_TYPE(WifiChannelView, wifi_channel_view, WIFI, CHANNEL_VIEW, GtkWidget)
+
+GtkWidget *wifi_channel_view_new(void);
+
+void wifi_channel_view_add_access_point(WifiChannelView *self, NMAccessPoint *ap);
+void wifi_channel_view_remove_access_point(WifiChannelView *self, NMAccessPoint *ap);
+void wifi_channel_view_set_active_access_point(WifiChannelView *self, NMAccessPoint *ap);
+
+G_END_DECLS
@@ -0,0 +1,244 @@
+/* wifi-connection-options.c
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "settings-config.h"
+#include "wifi-connection-options.h"
+#include "network-client.h"
+
+#include <adwaita.h>
+#include <net/ethernet.h>
+
+/* Row positions, in the order the choices are listed */
+enum
+{
+  BAND_AUTOMATIC,
+  BAND_5GHZ,
+  BAND_2GHZ,
+};
+
+enum
+{
+  POWERSAVE_DEFAULT,
+  POWERSAVE_ENABLED,
+  POWERSAVE_DISABLED,
+};
+
+typedef struct OptionsDialog
+{
+  NMDeviceWifi *device;
+  NMRemoteConnection *connection;
+
+  AdwComboRow *band_row;
+  AdwComboRow *bssid_row;
+  AdwComboRow *powersave_row;
+
+  /* BSSID per bssid_row position; NULL first, for any */
+  GPtrArray *bssids;
+
+  /* Positions the rows started at, so untouched ones aren't written */
+  guint band;
+  guint bssid;
+  guint powersave;
+} OptionsDialog;
+
+void wifi_connection_clamp_ap_to_bssid(NMAccessPoint *ap, NMSettingWireless *s_wifi)
+{
+  const char *str_bssid;
+
+  /* For a certain list of known ESSIDs which are commonly preset by ISPs
+   * and manufacturers and often unchanged by users, lock the connection
+   * to the BSSID so that we don't try to auto-connect to your grandma's
+   * neighbor's Wi-Fi.
+   */
+
+  str_bssid = nm_access_point_get_bssid(ap);
+  if (str_bssid && nm_utils_hwaddr_valid(str_bssid, ETH_ALEN))
+  {
+    g_object_set(G_OBJECT(s_wifi),
+                 NM_SETTING_WIRELESS_BSSID, str_bssid,
+                 NULL);
+  }
+}
+
+static void
+options_dialog_free(OptionsDialog *options)
+{
+  g_object_unref(options->device);
+  g_object_unref(options->connection);
+  g_ptr_array_unref(options->bssids);
+  g_free(options);
+}
+
+static const char *
+get_band_name(guint32 frequency)
+{
+  if (frequency < 3000)
+    return "2.4 GHz";
+  if (frequency < 5925)
+    return "5 GHz";
+
+  return "6 GHz";
+}
+
+static AdwComboRow *
+add_combo_row(AdwPreferencesGroup *group, const char *title, const char *subtitle, GtkStringList *choices, guint selected)
+{
+  AdwComboRow *row = ADW_COMBO_ROW(adw_combo_row_new());
+
+  adw_preferences_row_set_title(ADW_PREFERENCES_ROW(row), title);
+  adw_action_row_set_subtitle(ADW_ACTION_ROW(row), subtitle);
+  adw_combo_row_set_model(row, G_LIST_MODEL(choices));
+  adw_combo_row_set_selected(row, selected);
+  adw_preferences_group_add(group, GTK_WIDGET(row));
+  g_object_unref(choices);
+
+  return row;
+}
+
+static void
+on_dialog_closed(AdwDialog *dialog, OptionsDialog *options)
+{
+  NMSettingWireless *s_wifi = nm_connection_get_setting_wireless(NM_CONNECTION(options->connection));
+  guint band = adw_combo_row_get_selected(options->band_row);
+  guint bssid = adw_combo_row_get_selected(options->bssid_row);
+  guint powersave = adw_combo_row_get_selected(options->powersave_row);
+
+  if (!s_wifi || (band == options->band && bssid == options->bssid && powersave == options->powersave))
+  {
+    options_dialog_free(options);
+    return;
+  }
+
+  if (band != options->band)
+  {
+    /* A channel only makes sense within its old band */
+    g_object_set(s_wifi,
+                 NM_SETTING_WIRELESS_BAND, band == BAND_5GHZ ? "a" : band == BAND_2GHZ ? "bg" : NULL,
+                 NM_SETTING_WIRELESS_CHANNEL, 0,
+                 NULL);
+  }
+
+  if (bssid != options->bssid)
+    g_object_set(s_wifi, NM_SETTING_WIRELESS_BSSID, options->bssids->pdata[bssid], NULL);
+
+  if (powersave != options->powersave)
+  {
+    g_object_set(s_wifi,
+                 NM_SETTING_WIRELESS_POWERSAVE,
+                 powersave == POWERSAVE_ENABLED    ? NM_SETTING_WIRELESS_POWERSAVE_ENABLE
+                 : powersave == POWERSAVE_DISABLED ? NM_SETTING_WIRELESS_POWERSAVE_DISABLE
+                                                   : NM_SETTING_WIRELESS_POWERSAVE_DEFAULT,
+                 NULL);
+  }
+
+  /* Every change goes to NM at once */
+  network_client_commit_and_reapply(options->connection, NM_DEVICE(options->device));
+  options_dialog_free(options);
+}
+
+static void
+add_bssid_rows(OptionsDialog *options, AdwPreferencesGroup *group, NMSettingWireless *s_wifi, WifiNetwork *network)
+{
+  GtkStringList *choices = gtk_string_list_new((const char *[]){"Any", NULL});
+  const char *locked = nm_setting_wireless_get_bssid(s_wifi);
+
+  g_ptr_array_add(options->bssids, NULL);
+
+  for (guint i = 0; i < wifi_network_get_n_access_points(network); i++)
+  {
+    NMAccessPoint *ap = wifi_network_get_access_point(network, i);
+    const char *bssid = nm_access_point_get_bssid(ap);
+    char *label;
+
+    if (!bssid)
+      continue;
+
+    label = g_strdup_printf("%s · %s · %u%%", bssid, get_band_name(nm_access_point_get_frequency(ap)), nm_access_point_get_strength(ap));
+    gtk_string_list_take(choices, label);
+    g_ptr_array_add(options->bssids, g_strdup(bssid));
+
+    if (locked && nm_utils_hwaddr_matches(locked, -1, bssid, -1))
+      options->bssid = options->bssids->len - 1;
+  }
+
+  /* Locked to an access point that isn't in range right now */
+  if (locked && options->bssid == 0)
+  {
+    gtk_string_list_take(choices, g_strdup_printf("%s · not in range", locked));
+    g_ptr_array_add(options->bssids, g_strdup(locked));
+    options->bssid = options->bssids->len - 1;
+  }
+
+  options->bssid_row = add_combo_row(group, "Access point", "Stay on one access point instead of roaming", choices, options->bssid);
+}
+
+void wifi_connection_options_present(GtkWidget *parent, NMDeviceWifi *device, WifiNetwork *network)
+{
+  NMActiveConnection *active = nm_device_get_active_connection(NM_DEVICE(device));
+  NMRemoteConnection *connection = active ? nm_active_connection_get_connection(active) : NULL;
+  NMSettingWireless *s_wifi = connection ? nm_connection_get_setting_wireless(NM_CONNECTION(connection)) : NULL;
+  AdwPreferencesGroup *group;
+  AdwPreferencesPage *page;
+  AdwDialog *dialog;
+  OptionsDialog *options;
+  const char *band;
+
+  if (!s_wifi)
+    return;
+
+  options = g_new0(OptionsDialog, 1);
+  options->device = g_object_ref(device);
+  options->connection = g_object_ref(connection);
+  options->bssids = g_ptr_array_new_with_free_func(g_free);
+
+  band = nm_setting_wireless_get_band(s_wifi);
+  options->band = !g_strcmp0(band, "a") ? BAND_5GHZ : !g_strcmp0(band, "bg") ? BAND_2GHZ : BAND_AUTOMATIC;
+
+  switch (nm_setting_wireless_get_powersave(s_wifi))
+  {
+  case NM_SETTING_WIRELESS_POWERSAVE_ENABLE:
+    options->powersave = POWERSAVE_ENABLED;
+    break;
+  case NM_SETTING_WIRELESS_POWERSAVE_DISABLE:
+    options->powersave = POWERSAVE_DISABLED;
+    break;
+  default:
+    options->powersave = POWERSAVE_DEFAULT;
+  }
+
+  group = ADW_PREFERENCES_GROUP(adw_preferences_group_new());
+  adw_preferences_group_set_description(group, "Changes are applied when this dialog is closed. Some need the network to reconnect.");
+
+  options->band_row = add_combo_row(group, "Band", "Keep to one band, e.g. to stay off a crowded 2.4 GHz",
+                                    gtk_string_list_new((const char *[]){"Automatic", "5 GHz only", "2.4 GHz only", NULL}),
+                                    options->band);
+  add_bssid_rows(options, group, s_wifi, network);
+  options->powersave_row = add_combo_row(group, "Power saving", "Turning it off lowers latency at the cost of battery",
+                                         gtk_string_list_new((const char *[]){"Default", "On", "Off", NULL}),
+                                         options->powersave);
+
+  page = ADW_PREFERENCES_PAGE(adw_preferences_page_new());
+  adw_preferences_page_add(page, group);
+
+  dialog = ADW_DIALOG(adw_preferences_dialog_new());
+  adw_dialog_set_title(dialog, wifi_network_get_title(network));
+  adw_preferences_dialog_add(ADW_PREFERENCES_DIALOG(dialog), page);
+  g_signal_connect(dialog, "closed", G_CALLBACK(on_dialog_closed), options);
+
+  adw_dialog_present(dialog, parent);
+}
@@ -0,0 +1,38 @@
+/* wifi-connection-options.h
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+#include <NetworkManager.h>
+
+#include "wifi-network.h"
+
+G_BEGIN_DECLS
+
+/* Locks s_wifi to the BSSID of ap */
+void wifi_connection_clamp_ap_to_bssid(NMAccessPoint *ap, NMSettingWireless *s_wifi);
+
+/* Shows the band, BSSID lock and power saving options of the connection
+ * active on device, which is connected to network. The changes are
+ * saved with network_client_commit_and_reapply() when the dialog
+ * closes. */
+void wifi_connection_options_present(GtkWidget *parent, NMDeviceWifi *device, WifiNetwork *network);
+
+G_END_DECLS
@@ -0,0 +1,385 @@
+/* wifi-network.c
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "settings-config.h"
+#include "wifi-network.h"
+
+struct _WifiNetwork
+{
+  GObject parent_instance;
+
+  char *hash;
+  char *title;
+  GBytes *ssid;
+
+  /* NMAccessPoint, referenced */
+  GPtrArray *aps;
+  NMAccessPoint *best_ap;
+
+  gboolean connected;
+  gboolean known;
+
+  /* Restored from the scan cache and not seen live since */
+  gboolean stale;
+  guint8 cached_strength;
+
+  /* What the list is currently sorted by */
+  gboolean sort_connected;
+  gboolean sort_known;
+  guint8 sort_strength;
+};
+
+/* Strength has to move this far before the row does, so RSSI noise
+ * around a neighbour's value doesn't swap them back and forth */
+#define SORT_STRENGTH_HYSTERESIS 10
+
+enum
+{
+  PROP_0,
+  PROP_STRENGTH,
+  PROP_N_ACCESS_POINTS,
+  PROP_CONNECTED,
+  PROP_KNOWN,
+  PROP_STALE,
+  N_PROPS
+};
+
+static GParamSpec *properties[N_PROPS];
+
+G_DEFINE_TYPE(WifiNetwork, wifi_network, G_TYPE_OBJECT)
+
+static void on_ap_strength_changed(NMAccessPoint *ap, GParamSpec *pspec, WifiNetwork *self);
+
+static void
+wifi_network_finalize(GObject *object)
+{
+  WifiNetwork *self = WIFI_NETWORK(object);
+
+  for (guint i = 0; i < self->aps->len; i++)
+    g_signal_handlers_disconnect_by_func(self->aps->pdata[i], on_ap_strength_changed, self);
+
+  g_ptr_array_unref(self->aps);
+  g_clear_pointer(&self->ssid, g_bytes_unref);
+  g_free(self->hash);
+  g_free(self->title);
+
+  G_OBJECT_CLASS(wifi_network_parent_class)->finalize(object);
+}
+
+static void
+wifi_network_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+  WifiNetwork *self = WIFI_NETWORK(object);
+
+  switch (prop_id)
+  {
+  case PROP_STRENGTH:
+    g_value_set_uint(value, wifi_network_get_strength(self));
+    break;
+  case PROP_N_ACCESS_POINTS:
+    g_value_set_uint(value, self->aps->len);
+    break;
+  case PROP_CONNECTED:
+    g_value_set_boolean(value, self->connected);
+    break;
+  case PROP_KNOWN:
+    g_value_set_boolean(value, self->known);
+    break;
+  case PROP_STALE:
+    g_value_set_boolean(value, self->stale);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+  }
+}
+
+static void
+wifi_network_class_init(WifiNetworkClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+  object_class->finalize = wifi_network_finalize;
+  object_class->get_property = wifi_network_get_property;
+
+  properties[PROP_STRENGTH] = g_param_spec_uint("strength", NULL, NULL, 0, 100, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+  properties[PROP_N_ACCESS_POINTS] = g_param_spec_uint("n-access-points", NULL, NULL, 0, G_MAXUINT, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+  properties[PROP_CONNECTED] = g_param_spec_boolean("connected", NULL, NULL, FALSE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+  properties[PROP_KNOWN] = g_param_spec_boolean("known", NULL, NULL, FALSE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+  properties[PROP_STALE] = g_param_spec_boolean("stale", NULL, NULL, FALSE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties(object_class, N_PROPS, properties);
+}
+
+static void
+wifi_network_init(WifiNetwork *self)
+{
+  self->aps = g_ptr_array_new_with_free_func(g_object_unref);
+}
+
+/* Open, WEP, WPA personal and WPA enterprise BSSIDs of one SSID are kept
+ * apart because connecting to each needs different settings. */
+char *wifi_network_hash_access_point(NMAccessPoint *ap)
+{
+  GBytes *ssid = nm_access_point_get_ssid(ap);
+  NM80211ApFlags flags = nm_access_point_get_flags(ap);
+  NM80211ApSecurityFlags wpa_flags = nm_access_point_get_wpa_flags(ap);
+  NM80211ApSecurityFlags rsn_flags = nm_access_point_get_rsn_flags(ap);
+  GChecksum *checksum = g_checksum_new(G_CHECKSUM_MD5);
+  guint8 kind[2];
+  char *hash;
+
+  kind[0] = nm_access_point_get_mode(ap);
+
+  if (wpa_flags == NM_802_11_AP_SEC_NONE && rsn_flags == NM_802_11_AP_SEC_NONE)
+    kind[1] = (flags & NM_802_11_AP_FLAGS_PRIVACY) ? 1 : 0;
+  else if ((wpa_flags | rsn_flags) & NM_802_11_AP_SEC_KEY_MGMT_802_1X)
+    kind[1] = 3;
+  else
+    kind[1] = 2;
+
+  if (ssid)
+    g_checksum_update(checksum, g_bytes_get_data(ssid, NULL), g_bytes_get_size(ssid));
+  g_checksum_update(checksum, kind, sizeof(kind));
+  hash = g_strdup(g_checksum_get_string(checksum));
+  g_checksum_free(checksum);
+
+  return hash;
+}
+
+static WifiNetwork *
+network_new(GBytes *ssid, char *hash)
+{
+  WifiNetwork *self = g_object_new(WIFI_TYPE_NETWORK, NULL);
+
+  self->hash = hash;
+  self->ssid = ssid ? g_bytes_ref(ssid) : g_bytes_new(NULL, 0);
+  self->title = ssid ? nm_utils_ssid_to_utf8(g_bytes_get_data(ssid, NULL), g_bytes_get_size(ssid)) : g_strdup("");
+
+  return self;
+}
+
+/* Takes ownership of hash. The network starts out empty; add ap to it. */
+WifiNetwork *wifi_network_new(NMAccessPoint *ap, char *hash)
+{
+  return network_new(nm_access_point_get_ssid(ap), hash);
+}
+
+/* Takes ownership of hash */
+WifiNetwork *wifi_network_new_cached(GBytes *ssid, char *hash, guint8 strength)
+{
+  WifiNetwork *self = network_new(ssid, hash);
+
+  self->stale = TRUE;
+  self->cached_strength = MIN(strength, 100);
+
+  return self;
+}
+
+const char *wifi_network_get_hash(WifiNetwork *self)
+{
+  return self->hash;
+}
+
+const char *wifi_network_get_title(WifiNetwork *self)
+{
+  return self->title;
+}
+
+GBytes *wifi_network_get_ssid(WifiNetwork *self)
+{
+  return self->ssid;
+}
+
+NMAccessPoint *wifi_network_get_best_access_point(WifiNetwork *self)
+{
+  return self->best_ap;
+}
+
+guint8 wifi_network_get_strength(WifiNetwork *self)
+{
+  if (self->best_ap)
+    return nm_access_point_get_strength(self->best_ap);
+
+  return self->stale ? self->cached_strength : 0;
+}
+
+guint wifi_network_get_n_access_points(WifiNetwork *self)
+{
+  return self->aps->len;
+}
+
+NMAccessPoint *wifi_network_get_access_point(WifiNetwork *self, guint index)
+{
+  g_return_val_if_fail(index < self->aps->len, NULL);
+
+  return self->aps->pdata[index];
+}
+
+const char *wifi_network_get_icon_name(WifiNetwork *self)
+{
+  guint8 strength = wifi_network_get_strength(self);
+
+  if (strength > 80)
+    return "network-wireless-signal-excellent-symbolic";
+  if (strength > 55)
+    return "network-wireless-signal-good-symbolic";
+  if (strength > 30)
+    return "network-wireless-signal-ok-symbolic";
+  if (strength > 5)
+    return "network-wireless-signal-weak-symbolic";
+
+  return "network-wireless-signal-none-symbolic";
+}
+
+gboolean wifi_network_get_connected(WifiNetwork *self)
+{
+  return self->connected;
+}
+
+void wifi_network_set_connected(WifiNetwork *self, gboolean connected)
+{
+  if (self->connected == !!connected)
+    return;
+
+  self->connected = !!connected;
+  g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_CONNECTED]);
+}
+
+gboolean wifi_network_get_known(WifiNetwork *self)
+{
+  return self->known;
+}
+
+void wifi_network_set_known(WifiNetwork *self, gboolean known)
+{
+  if (self->known == !!known)
+    return;
+
+  self->known = !!known;
+  g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_KNOWN]);
+}
+
+gboolean wifi_network_get_stale(WifiNetwork *self)
+{
+  return self->stale;
+}
+
+gboolean wifi_network_sort_key_is_stale(WifiNetwork *self)
+{
+  int drift = (int)wifi_network_get_strength(self) - self->sort_strength;
+
+  return self->connected != self->sort_connected || self->known != self->sort_known || ABS(drift) >= SORT_STRENGTH_HYSTERESIS;
+}
+
+void wifi_network_commit_sort_key(WifiNetwork *self)
+{
+  self->sort_connected = self->connected;
+  self->sort_known = self->known;
+  self->sort_strength = wifi_network_get_strength(self);
+}
+
+int wifi_network_compare(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  WifiNetwork *network_a = WIFI_NETWORK((gpointer)a);
+  WifiNetwork *network_b = WIFI_NETWORK((gpointer)b);
+
+  if (network_a->sort_connected != network_b->sort_connected)
+    return network_a->sort_connected ? -1 : 1;
+  if (network_a->sort_known != network_b->sort_known)
+    return network_a->sort_known ? -1 : 1;
+  if (network_a->sort_strength != network_b->sort_strength)
+    return network_b->sort_strength - network_a->sort_strength;
+
+  /* Keep equal networks in a stable order */
+  return g_utf8_collate(network_a->title, network_b->title);
+}
+
+static void
+update_best_access_point(WifiNetwork *self)
+{
+  self->best_ap = self->aps->len ? self->aps->pdata[0] : NULL;
+
+  for (guint i = 1; i < self->aps->len; i++)
+  {
+    NMAccessPoint *other = self->aps->pdata[i];
+
+    if (nm_access_point_get_strength(other) > nm_access_point_get_strength(self->best_ap))
+      self->best_ap = other;
+  }
+}
+
+static void
+on_ap_strength_changed(NMAccessPoint *ap, GParamSpec *pspec, WifiNetwork *self)
+{
+  guint8 old_strength = wifi_network_get_strength(self);
+
+  /* Only the BSSIDs of this one network need to be looked at */
+  update_best_access_point(self);
+
+  if (wifi_network_get_strength(self) != old_strength)
+    g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_STRENGTH]);
+}
+
+void wifi_network_add_access_point(WifiNetwork *self, NMAccessPoint *ap)
+{
+  guint8 old_strength = wifi_network_get_strength(self);
+
+  g_ptr_array_add(self->aps, g_object_ref(ap));
+  g_signal_connect(ap, "notify::" NM_ACCESS_POINT_STRENGTH, G_CALLBACK(on_ap_strength_changed), self);
+
+  if (!self->best_ap || nm_access_point_get_strength(ap) > old_strength)
+    self->best_ap = ap;
+
+  /* The cached strength is only a stand-in until the first live BSSID */
+  if (self->stale)
+  {
+    self->stale = FALSE;
+    g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_STALE]);
+  }
+
+  g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_N_ACCESS_POINTS]);
+  if (wifi_network_get_strength(self) != old_strength)
+    g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_STRENGTH]);
+}
+
+gboolean wifi_network_remove_access_point(WifiNetwork *self, NMAccessPoint *ap)
+{
+  guint8 old_strength = wifi_network_get_strength(self);
+
+  /* The caller still holds the AP, so comparing against it is safe */
+  if (!g_ptr_array_find(self->aps, ap, NULL))
+    return self->aps->len > 0;
+
+  g_signal_handlers_disconnect_by_func(ap, on_ap_strength_changed, self);
+  g_ptr_array_remove_fast(self->aps, ap);
+
+  if (self->aps->len == 0)
+  {
+    self->best_ap = NULL;
+    return FALSE;
+  }
+
+  if (self->best_ap == ap)
+    update_best_access_point(self);
+
+  g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_N_ACCESS_POINTS]);
+  if (wifi_network_get_strength(self) != old_strength)
+    g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_STRENGTH]);
+
+  return TRUE;
+}
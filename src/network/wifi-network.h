@@ -0,0 +1,78 @@
+/* wifi-network.h
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include <NetworkManager.h>
+
+G_BEGIN_DECLS
+
+/* One Wi-Fi network as shown in the list: every BSSID with the same SSID,
+ * mode and kind of security, merged. "strength", "n-access-points",
+ * "connected" and "known" are notified when they change so bound rows can
+ * follow them.
+ *
+ * A network restored from the scan cache has no access points yet and is
+ * "stale", showing the strength it had when it was cached, until the
+ * first live BSSID is added.
+ *
+ * The list is ordered by a snapshot of those values, the sort key, rather
+ * than the live ones, so a sorted model never sees an item change under
+ * it. The key only catches up through wifi_network_commit_sort_key(),
+ * which the owner calls right before it tells the model the item moved.
+ */
+#define WIFI_TYPE_NETWORK (wifi_network_get_type())
+
+G_DECLARE_FINAL_TYPE(WifiNetwork, wifi_network, WIFI, NETWORK, GObject)
+
+/* Returns the key that groups BSSIDs into networks */
+char *wifi_network_hash_access_point(NMAccessPoint *ap);
+
+WifiNetwork *wifi_network_new(NMAccessPoint *ap, char *hash);
+WifiNetwork *wifi_network_new_cached(GBytes *ssid, char *hash, guint8 strength);
+
+const char *wifi_network_get_hash(WifiNetwork *self);
+const char *wifi_network_get_title(WifiNetwork *self);
+GBytes *wifi_network_get_ssid(WifiNetwork *self);
+NMAccessPoint *wifi_network_get_best_access_point(WifiNetwork *self);
+guint8 wifi_network_get_strength(WifiNetwork *self);
+guint wifi_network_get_n_access_points(WifiNetwork *self);
+NMAccessPoint *wifi_network_get_access_point(WifiNetwork *self, guint index);
+const char *wifi_network_get_icon_name(WifiNetwork *self);
+
+gboolean wifi_network_get_connected(WifiNetwork *self);
+void wifi_network_set_connected(WifiNetwork *self, gboolean connected);
+gboolean wifi_network_get_known(WifiNetwork *self);
+void wifi_network_set_known(WifiNetwork *self, gboolean known);
+gboolean wifi_network_get_stale(WifiNetwork *self);
+
+/* TRUE when the network should move: it was connected, forgotten or
+ * saved, or its strength drifted past the hysteresis */
+gboolean wifi_network_sort_key_is_stale(WifiNetwork *self);
+void wifi_network_commit_sort_key(WifiNetwork *self);
+
+/* Connected first, then known, then strongest */
+int wifi_network_compare(gconstpointer a, gconstpointer b, gpointer user_data);
+
+void wifi_network_add_access_point(WifiNetwork *self, NMAccessPoint *ap);
+/* Returns FALSE once the last access point is gone */
+gboolean wifi_network_remove_access_point(WifiNetwork *self, NMAccessPoint *ap);
+
+G_END_DECLS
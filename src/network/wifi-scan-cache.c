@@ -0,0 +1,150 @@
+/* wifi-scan-cache.c
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "settings-config.h"
+#include "wifi-scan-cache.h"
+#include "wifi-network.h"
+
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+
+/* (version, saved at in seconds since the epoch,
+ *  [(network hash, SSID, strength)]) */
+#define CACHE_TYPE "(uxa(sayy))"
+#define CACHE_VERSION 1
+
+/* Older than this the networks are probably somewhere else entirely */
+#define CACHE_MAX_AGE_S (24 * 60 * 60)
+
+static char *
+get_cache_path(NMDeviceWifi *device)
+{
+  const char *iface = nm_device_get_iface(NM_DEVICE(device));
+  char *name, *path;
+
+  if (!iface || strchr(iface, '/'))
+    return NULL;
+
+  name = g_strconcat("wifi-scan-", iface, ".gvariant", NULL);
+  path = g_build_filename(g_get_user_cache_dir(), "plenjos-settings", name, NULL);
+  g_free(name);
+
+  return path;
+}
+
+GPtrArray *wifi_scan_cache_load(NMDeviceWifi *device)
+{
+  GPtrArray *networks = g_ptr_array_new_with_free_func(g_object_unref);
+  char *path = get_cache_path(device);
+  GMappedFile *file;
+  GVariant *cache, *entries;
+  guint32 version;
+  gint64 saved_at;
+
+  file = path ? g_mapped_file_new(path, FALSE, NULL) : NULL;
+  g_free(path);
+
+  if (!file)
+    return networks;
+
+  /* GVariant copes with a truncated or corrupt file by reading defaults */
+  cache = g_variant_new_from_bytes(G_VARIANT_TYPE(CACHE_TYPE), g_mapped_file_get_bytes(file), FALSE);
+  g_variant_ref_sink(cache);
+  g_mapped_file_unref(file);
+
+  g_variant_get(cache, "(ux@a(sayy))", &version, &saved_at, &entries);
+
+  if (version == CACHE_VERSION && g_get_real_time() / G_USEC_PER_SEC - saved_at < CACHE_MAX_AGE_S)
+  {
+    gsize n_entries = g_variant_n_children(entries);
+
+    for (gsize i = 0; i < n_entries; i++)
+    {
+      GVariant *ssid_variant;
+      const char *hash;
+      guint8 strength;
+      GBytes *ssid;
+
+      g_variant_get_child(entries, i, "(&s@ayy)", &hash, &ssid_variant, &strength);
+      ssid = g_variant_get_data_as_bytes(ssid_variant);
+
+      g_ptr_array_add(networks, wifi_network_new_cached(ssid, g_strdup(hash), strength));
+
+      g_bytes_unref(ssid);
+      g_variant_unref(ssid_variant);
+    }
+  }
+
+  g_variant_unref(entries);
+  g_variant_unref(cache);
+
+  return networks;
+}
+
+void wifi_scan_cache_save(NMDeviceWifi *device, GListModel *model)
+{
+  GVariantBuilder entries;
+  GError *error = NULL;
+  GVariant *cache;
+  char *path, *dir;
+  guint n_live = 0;
+
+  g_variant_builder_init(&entries, G_VARIANT_TYPE("a(sayy)"));
+
+  for (guint i = 0; i < g_list_model_get_n_items(model); i++)
+  {
+    WifiNetwork *network = g_list_model_get_item(model, i);
+
+    if (!wifi_network_get_stale(network))
+    {
+      GBytes *ssid = wifi_network_get_ssid(network);
+
+      g_variant_builder_add(&entries, "(s@ayy)",
+                            wifi_network_get_hash(network),
+                            g_variant_new_from_bytes(G_VARIANT_TYPE_BYTESTRING, ssid, TRUE),
+                            wifi_network_get_strength(network));
+      n_live++;
+    }
+
+    g_object_unref(network);
+  }
+
+  path = n_live > 0 ? get_cache_path(device) : NULL;
+  if (!path)
+  {
+    g_variant_builder_clear(&entries);
+    return;
+  }
+
+  cache = g_variant_ref_sink(g_variant_new(CACHE_TYPE, CACHE_VERSION, g_get_real_time() / G_USEC_PER_SEC, &entries));
+  dir = g_path_get_dirname(path);
+
+  if (g_mkdir_with_parents(dir, 0700) < 0 ||
+      !g_file_set_contents(path, g_variant_get_data(cache), g_variant_get_size(cache), &error))
+  {
+    fprintf(stderr, "Failed to save the Wi-Fi scan cache. %s.\n", error ? error->message : g_strerror(errno));
+    fflush(stderr);
+    g_clear_error(&error);
+  }
+
+  g_variant_unref(cache);
+  g_free(dir);
+  g_free(path);
+}
@@ -0,0 +1,40 @@
+/* wifi-scan-cache.h
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include <NetworkManager.h>
+
+G_BEGIN_DECLS
+
+/* The networks last seen by a Wi-Fi device, kept in
+ * $XDG_CACHE_HOME/plenjos-settings so the list has something to show
+ * before the first scan of a session has finished.
+ */
+
+/* Returns the cached networks of device as stale WifiNetworks, or an
+ * empty array when there is no usable cache. */
+GPtrArray *wifi_scan_cache_load(NMDeviceWifi *device);
+
+/* Replaces the device's cache with the networks in model that were seen
+ * live. A model with nothing live leaves the old cache alone. */
+void wifi_scan_cache_save(NMDeviceWifi *device, GListModel *model);
+
+G_END_DECLS
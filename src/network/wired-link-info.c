@@ -0,0 +1,210 @@
+/* wired-link-info.c
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "settings-config.h"
+#include "wired-link-info.h"
+
+#include <errno.h>
+#include <linux/ethtool.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sockios.h>
+#include <net/if.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int
+ethtool_ioctl(int fd, const char *iface, void *data)
+{
+  struct ifreq ifr = {0};
+
+  g_strlcpy(ifr.ifr_name, iface, sizeof(ifr.ifr_name));
+  ifr.ifr_data = data;
+
+  return ioctl(fd, SIOCETHTOOL, &ifr);
+}
+
+/* Returns the flag, or -1 if the driver doesn't report it */
+static int
+get_flag(int fd, const char *iface, guint32 cmd)
+{
+  struct ethtool_value value = {.cmd = cmd};
+
+  if (ethtool_ioctl(fd, iface, &value) < 0)
+    return -1;
+
+  return value.data ? 1 : 0;
+}
+
+static void
+read_link_settings(int fd, const char *iface, WiredLinkInfo *info)
+{
+  /* The kernel answers this from the newer link settings as well */
+  struct ethtool_cmd cmd = {.cmd = ETHTOOL_GSET};
+  guint32 speed;
+
+  if (ethtool_ioctl(fd, iface, &cmd) < 0)
+    return;
+
+  speed = ethtool_cmd_speed(&cmd);
+  if (speed != 0 && speed != (guint32)SPEED_UNKNOWN)
+    info->speed = speed;
+
+  if (cmd.duplex == DUPLEX_FULL || cmd.duplex == DUPLEX_HALF)
+    info->full_duplex = cmd.duplex == DUPLEX_FULL;
+}
+
+static void
+read_rings(int fd, const char *iface, WiredLinkInfo *info)
+{
+  struct ethtool_ringparam rings = {.cmd = ETHTOOL_GRINGPARAM};
+
+  if (ethtool_ioctl(fd, iface, &rings) < 0)
+    return;
+
+  info->rx_ring = rings.rx_pending;
+  info->rx_ring_max = rings.rx_max_pending;
+  info->tx_ring = rings.tx_pending;
+  info->tx_ring_max = rings.tx_max_pending;
+}
+
+/* The MTU limits aren't in any ioctl, only in the netlink link message.
+ * Drivers without limits (lo) report 0, which is left as unknown. */
+static void
+read_mtu_range(const char *iface, WiredLinkInfo *info)
+{
+  struct
+  {
+    struct nlmsghdr header;
+    struct ifinfomsg ifi;
+  } request = {
+      .header = {.nlmsg_len = sizeof(request), .nlmsg_type = RTM_GETLINK, .nlmsg_flags = NLM_F_REQUEST},
+      .ifi = {.ifi_family = AF_UNSPEC},
+  };
+  guint32 buffer[8192];
+  struct nlmsghdr *header;
+  ssize_t length;
+  int fd;
+
+  request.ifi.ifi_index = if_nametoindex(iface);
+  if (request.ifi.ifi_index == 0)
+    return;
+
+  fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (fd < 0)
+    return;
+
+  if (send(fd, &request, sizeof(request), 0) < 0 || (length = recv(fd, buffer, sizeof(buffer), 0)) < 0)
+  {
+    close(fd);
+    return;
+  }
+
+  close(fd);
+
+  for (header = (struct nlmsghdr *)buffer; NLMSG_OK(header, length); header = NLMSG_NEXT(header, length))
+  {
+    struct ifinfomsg *ifi = NLMSG_DATA(header);
+    int attr_length;
+
+    if (header->nlmsg_type != RTM_NEWLINK)
+      continue;
+
+    attr_length = IFLA_PAYLOAD(header);
+    for (struct rtattr *attr = IFLA_RTA(ifi); RTA_OK(attr, attr_length); attr = RTA_NEXT(attr, attr_length))
+    {
+      guint32 value = *(guint32 *)RTA_DATA(attr);
+
+      if (attr->rta_type == IFLA_MIN_MTU && value > 0)
+        info->min_mtu = MIN(value, G_MAXINT);
+      else if (attr->rta_type == IFLA_MAX_MTU && value > 0)
+        info->max_mtu = MIN(value, G_MAXINT);
+    }
+  }
+}
+
+static void
+read_link_info(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+  const char *iface = task_data;
+  WiredLinkInfo *info;
+  struct ifreq ifr = {0};
+  int fd;
+
+  fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    int saved_errno = errno;
+    g_task_return_new_error(task, G_IO_ERROR, g_io_error_from_errno(saved_errno), "Failed to open a socket: %s", g_strerror(saved_errno));
+    return;
+  }
+
+  /* Every field starts out as -1, unknown */
+  info = g_new(WiredLinkInfo, 1);
+  memset(info, 0xff, sizeof(*info));
+
+  g_strlcpy(ifr.ifr_name, iface, sizeof(ifr.ifr_name));
+  if (ioctl(fd, SIOCGIFMTU, &ifr) == 0)
+    info->mtu = ifr.ifr_mtu;
+
+  read_mtu_range(iface, info);
+  read_link_settings(fd, iface, info);
+
+  info->tso = get_flag(fd, iface, ETHTOOL_GTSO);
+  info->gso = get_flag(fd, iface, ETHTOOL_GGSO);
+  info->gro = get_flag(fd, iface, ETHTOOL_GGRO);
+  info->rx_checksum = get_flag(fd, iface, ETHTOOL_GRXCSUM);
+  info->tx_checksum = get_flag(fd, iface, ETHTOOL_GTXCSUM);
+
+  read_rings(fd, iface, info);
+
+  close(fd);
+
+  g_task_return_pointer(task, info, g_free);
+}
+
+void wired_link_info_read_async(const char *iface,
+                                GCancellable *cancellable,
+                                GAsyncReadyCallback callback,
+                                gpointer user_data)
+{
+  GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+
+  g_task_set_source_tag(task, wired_link_info_read_async);
+  g_task_set_task_data(task, g_strdup(iface), g_free);
+  g_task_set_return_on_cancel(task, TRUE);
+
+  if (!iface || strlen(iface) >= IFNAMSIZ)
+    g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Invalid interface name");
+  else
+    g_task_run_in_thread(task, read_link_info);
+
+  g_object_unref(task);
+}
+
+WiredLinkInfo *wired_link_info_read_finish(GAsyncResult *result,
+                                           GError **error)
+{
+  g_return_val_if_fail(g_task_is_valid(result, NULL), NULL);
+  g_return_val_if_fail(g_task_get_source_tag(G_TASK(result)) == wired_link_info_read_async, NULL);
+
+  return g_task_propagate_pointer(G_TASK(result), error);
+}
@@ -0,0 +1,60 @@
+/* wired-link-info.h
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Link and NIC details of a wired interface, read with the ethtool
+ * ioctls. Anything the driver doesn't report is -1: veth and dummy
+ * have no rings, for example, and a link that is down has no speed.
+ */
+typedef struct WiredLinkInfo
+{
+  /* Mb/s */
+  int speed;
+  /* 1 for full, 0 for half */
+  int full_duplex;
+  int mtu;
+  /* What the driver accepts, from netlink */
+  int min_mtu;
+  int max_mtu;
+
+  int tso;
+  int gso;
+  int gro;
+  int rx_checksum;
+  int tx_checksum;
+
+  int rx_ring;
+  int rx_ring_max;
+  int tx_ring;
+  int tx_ring_max;
+} WiredLinkInfo;
+
+/* The ioctls run in a worker thread */
+void wired_link_info_read_async(const char *iface,
+                                GCancellable *cancellable,
+                                GAsyncReadyCallback callback,
+                                gpointer user_data);
+WiredLinkInfo *wired_link_info_read_finish(GAsyncResult *result,
+                                           GError **error);
+
+G_END_DECLS
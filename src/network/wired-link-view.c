@@ -0,0 +1,352 @@
+/* wired-link-view.c
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "settings-config.h"
+#include "wired-link-view.h"
+#include "network-client.h"
+#include "wired-link-info.h"
+
+#include <stdio.h>
+
+/* From the IPv4 minimum datagram size up to common jumbo frames, for
+ * drivers that don't report their own limits */
+#define MTU_MIN 576
+#define MTU_MAX 9216
+
+enum
+{
+  ROW_SPEED,
+  ROW_DUPLEX,
+  ROW_TSO,
+  ROW_GSO,
+  ROW_GRO,
+  ROW_RX_CHECKSUM,
+  ROW_TX_CHECKSUM,
+  ROW_RX_RING,
+  ROW_TX_RING,
+  N_ROWS
+};
+
+struct _WiredLinkView
+{
+  AdwBin parent_instance;
+
+  NMDevice *device;
+  GCancellable *cancellable;
+
+  AdwActionRow *rows[N_ROWS];
+  AdwSpinRow *mtu_row;
+  GtkWidget *mtu_apply;
+
+  /* The MTU from the last read; -1 until there is one */
+  int mtu;
+  /* The row holds a value the user typed, not the last read */
+  gboolean mtu_edited;
+  gboolean updating_mtu;
+};
+
+G_DEFINE_TYPE(WiredLinkView, wired_link_view, ADW_TYPE_BIN)
+
+static void
+set_row(WiredLinkView *self, int row, const char *value)
+{
+  adw_action_row_set_subtitle(self->rows[row], value ? value : "Unknown");
+}
+
+static void
+set_flag_row(WiredLinkView *self, int row, int flag)
+{
+  set_row(self, row, flag < 0 ? "Not supported" : flag ? "On" : "Off");
+}
+
+static void
+set_ring_row(WiredLinkView *self, int row, int pending, int max)
+{
+  char *text = pending < 0 ? NULL : g_strdup_printf("%d of %d", pending, max);
+
+  set_row(self, row, text ? text : "Not supported");
+  g_free(text);
+}
+
+/* Returns the wired setting the MTU goes in, adding one to an Ethernet
+ * profile that doesn't have it yet, or NULL if there is nothing to edit */
+static NMSettingWired *
+get_wired_setting(WiredLinkView *self, NMRemoteConnection **connection)
+{
+  NMActiveConnection *active = nm_device_get_active_connection(self->device);
+  NMSettingWired *s_wired;
+
+  *connection = active ? nm_active_connection_get_connection(active) : NULL;
+  if (!*connection)
+    return NULL;
+
+  s_wired = nm_connection_get_setting_wired(NM_CONNECTION(*connection));
+  if (!s_wired && nm_connection_is_type(NM_CONNECTION(*connection), NM_SETTING_WIRED_SETTING_NAME))
+  {
+    s_wired = NM_SETTING_WIRED(nm_setting_wired_new());
+    nm_connection_add_setting(NM_CONNECTION(*connection), NM_SETTING(s_wired));
+  }
+
+  return s_wired;
+}
+
+static void
+update_mtu_apply(WiredLinkView *self)
+{
+  NMActiveConnection *active = nm_device_get_active_connection(self->device);
+  NMRemoteConnection *connection = active ? nm_active_connection_get_connection(active) : NULL;
+  gboolean editable = connection &&
+                      (nm_connection_get_setting_wired(NM_CONNECTION(connection)) ||
+                       nm_connection_is_type(NM_CONNECTION(connection), NM_SETTING_WIRED_SETTING_NAME));
+
+  gtk_widget_set_sensitive(GTK_WIDGET(self->mtu_row), editable);
+  gtk_widget_set_visible(self->mtu_apply, editable && self->mtu > 0 && self->mtu_edited);
+}
+
+static void
+on_link_info_read(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+  WiredLinkView *self;
+  WiredLinkInfo *info;
+  GError *error = NULL;
+  char *text;
+
+  info = wired_link_info_read_finish(result, &error);
+
+  if (!info)
+  {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      fprintf(stderr, "Failed to read the link settings. %s.\n", error->message);
+      fflush(stderr);
+    }
+    g_error_free(error);
+    return;
+  }
+
+  self = WIRED_LINK_VIEW(user_data);
+
+  text = info->speed < 0 ? NULL : info->speed % 1000 ? g_strdup_printf("%d Mb/s", info->speed) : g_strdup_printf("%d Gb/s", info->speed / 1000);
+  set_row(self, ROW_SPEED, text);
+  g_free(text);
+
+  set_row(self, ROW_DUPLEX, info->full_duplex < 0 ? NULL : info->full_duplex ? "Full" : "Half");
+
+  set_flag_row(self, ROW_TSO, info->tso);
+  set_flag_row(self, ROW_GSO, info->gso);
+  set_flag_row(self, ROW_GRO, info->gro);
+  set_flag_row(self, ROW_RX_CHECKSUM, info->rx_checksum);
+  set_flag_row(self, ROW_TX_CHECKSUM, info->tx_checksum);
+
+  set_ring_row(self, ROW_RX_RING, info->rx_ring, info->rx_ring_max);
+  set_ring_row(self, ROW_TX_RING, info->tx_ring, info->tx_ring_max);
+
+  /* Follow the MTU unless the user is in the middle of changing it. The
+   * range comes from the driver where it says (veth goes up to 65535),
+   * and always takes in the current MTU, so it is never clamped into a
+   * value nobody chose. */
+  self->mtu = info->mtu;
+  if (info->mtu > 0 && !self->mtu_edited)
+  {
+    int min = info->min_mtu > 0 ? info->min_mtu : MTU_MIN;
+    int max = info->max_mtu > 0 ? info->max_mtu : MTU_MAX;
+
+    self->updating_mtu = TRUE;
+    adw_spin_row_set_range(self->mtu_row, MIN(min, info->mtu), MAX(max, info->mtu));
+    adw_spin_row_set_value(self->mtu_row, info->mtu);
+    self->updating_mtu = FALSE;
+  }
+  update_mtu_apply(self);
+
+  g_free(info);
+}
+
+static void
+refresh(WiredLinkView *self)
+{
+  const char *iface = nm_device_get_ip_iface(self->device);
+
+  if (!gtk_widget_get_mapped(GTK_WIDGET(self)))
+    return;
+
+  /* Only the latest read matters */
+  if (self->cancellable)
+    g_cancellable_cancel(self->cancellable);
+  g_clear_object(&self->cancellable);
+  self->cancellable = g_cancellable_new();
+
+  wired_link_info_read_async(iface ? iface : nm_device_get_iface(self->device), self->cancellable, on_link_info_read, self);
+}
+
+static void
+on_device_changed(NMDevice *device, GParamSpec *pspec, WiredLinkView *self)
+{
+  refresh(self);
+}
+
+static void
+on_mtu_changed(AdwSpinRow *row, GParamSpec *pspec, WiredLinkView *self)
+{
+  if (!self->updating_mtu)
+    self->mtu_edited = (int)adw_spin_row_get_value(row) != self->mtu;
+
+  update_mtu_apply(self);
+}
+
+static void
+on_mtu_apply(GtkButton *button, WiredLinkView *self)
+{
+  NMRemoteConnection *connection;
+  NMSettingWired *s_wired = get_wired_setting(self, &connection);
+
+  if (!s_wired)
+    return;
+
+  g_object_set(s_wired, NM_SETTING_WIRED_MTU, (guint)adw_spin_row_get_value(self->mtu_row), NULL);
+  network_client_commit_and_reapply(connection, self->device);
+
+  /* The next read shows whether it took */
+  self->mtu_edited = FALSE;
+  gtk_widget_set_visible(self->mtu_apply, FALSE);
+}
+
+static AdwActionRow *
+add_row(AdwPreferencesGroup *group, const char *title)
+{
+  AdwActionRow *row = ADW_ACTION_ROW(adw_action_row_new());
+
+  adw_preferences_row_set_title(ADW_PREFERENCES_ROW(row), title);
+  adw_action_row_set_subtitle(row, "…");
+  gtk_widget_add_css_class(GTK_WIDGET(row), "property");
+  adw_preferences_group_add(group, GTK_WIDGET(row));
+
+  return row;
+}
+
+static AdwPreferencesGroup *
+add_group(AdwPreferencesPage *page, const char *title)
+{
+  AdwPreferencesGroup *group = ADW_PREFERENCES_GROUP(adw_preferences_group_new());
+
+  adw_preferences_group_set_title(group, title);
+  adw_preferences_page_add(page, group);
+
+  return group;
+}
+
+static void
+wired_link_view_map(GtkWidget *widget)
+{
+  GTK_WIDGET_CLASS(wired_link_view_parent_class)->map(widget);
+
+  refresh(WIRED_LINK_VIEW(widget));
+}
+
+static void
+wired_link_view_unmap(GtkWidget *widget)
+{
+  WiredLinkView *self = WIRED_LINK_VIEW(widget);
+
+  if (self->cancellable)
+    g_cancellable_cancel(self->cancellable);
+  g_clear_object(&self->cancellable);
+
+  GTK_WIDGET_CLASS(wired_link_view_parent_class)->unmap(widget);
+}
+
+static void
+wired_link_view_dispose(GObject *object)
+{
+  WiredLinkView *self = WIRED_LINK_VIEW(object);
+
+  if (self->cancellable)
+    g_cancellable_cancel(self->cancellable);
+  g_clear_object(&self->cancellable);
+
+  if (self->device)
+    g_signal_handlers_disconnect_by_data(self->device, self);
+  g_clear_object(&self->device);
+
+  G_OBJECT_CLASS(wired_link_view_parent_class)->dispose(object);
+}
+
+static void
+wired_link_view_class_init(WiredLinkViewClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+
+  object_class->dispose = wired_link_view_dispose;
+
+  widget_class->map = wired_link_view_map;
+  widget_class->unmap = wired_link_view_unmap;
+}
+
+static void
+wired_link_view_init(WiredLinkView *self)
+{
+  AdwPreferencesPage *page = ADW_PREFERENCES_PAGE(adw_preferences_page_new());
+  AdwPreferencesGroup *group;
+
+  self->mtu = -1;
+
+  group = add_group(page, "Link");
+  self->rows[ROW_SPEED] = add_row(group, "Speed");
+  self->rows[ROW_DUPLEX] = add_row(group, "Duplex");
+
+  self->mtu_row = ADW_SPIN_ROW(adw_spin_row_new_with_range(MTU_MIN, MTU_MAX, 1));
+  adw_preferences_row_set_title(ADW_PREFERENCES_ROW(self->mtu_row), "MTU");
+  adw_action_row_set_subtitle(ADW_ACTION_ROW(self->mtu_row), "Larger values enable jumbo frames");
+  self->mtu_apply = gtk_button_new_with_label("Apply");
+  gtk_widget_set_valign(self->mtu_apply, GTK_ALIGN_CENTER);
+  gtk_widget_add_css_class(self->mtu_apply, "suggested-action");
+  gtk_widget_set_visible(self->mtu_apply, FALSE);
+  adw_action_row_add_suffix(ADW_ACTION_ROW(self->mtu_row), self->mtu_apply);
+  adw_preferences_group_add(group, GTK_WIDGET(self->mtu_row));
+
+  g_signal_connect(self->mtu_row, "notify::value", G_CALLBACK(on_mtu_changed), self);
+  g_signal_connect(self->mtu_apply, "clicked", G_CALLBACK(on_mtu_apply), self);
+
+  group = add_group(page, "Offloads");
+  self->rows[ROW_TSO] = add_row(group, "TCP segmentation offload");
+  self->rows[ROW_GSO] = add_row(group, "Generic segmentation offload");
+  self->rows[ROW_GRO] = add_row(group, "Generic receive offload");
+  self->rows[ROW_RX_CHECKSUM] = add_row(group, "Receive checksumming");
+  self->rows[ROW_TX_CHECKSUM] = add_row(group, "Transmit checksumming");
+
+  group = add_group(page, "Rings");
+  self->rows[ROW_RX_RING] = add_row(group, "Receive ring");
+  self->rows[ROW_TX_RING] = add_row(group, "Transmit ring");
+
+  gtk_widget_set_vexpand(GTK_WIDGET(self), TRUE);
+  adw_bin_set_child(ADW_BIN(self), GTK_WIDGET(page));
+}
+
+GtkWidget *wired_link_view_new(NMDevice *device)
+{
+  WiredLinkView *self = g_object_new(WIRED_TYPE_LINK_VIEW, NULL);
+
+  self->device = g_object_ref(device);
+
+  /* Speed and duplex come and go with the link, and NM sets the MTU */
+  g_signal_connect(device, "notify::" NM_DEVICE_STATE, G_CALLBACK(on_device_changed), self);
+  g_signal_connect(device, "notify::" NM_DEVICE_MTU, G_CALLBACK(on_device_changed), self);
+  g_signal_connect(device, "notify::" NM_DEVICE_ACTIVE_CONNECTION, G_CALLBACK(on_device_changed), self);
+
+  return GTK_WIDGET(self);
+}
@@ -0,0 +1,38 @@
+/* wired-link-view.h
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+#include <adwaita.h>
+
+#include <NetworkManager.h>
+
+G_BEGIN_DECLS
+
+/* Speed, duplex, MTU, offloads and ring sizes of a wired device, read
+ * whenever the view is mapped or the device changes state. The MTU can
+ * be changed in the active connection's 802-3-ethernet setting.
+ */
+#define WIRED_TYPE_LINK_VIEW (wired_link_view_get_type())
+
+G_DECLARE_FINAL_TYPE(WiredLinkView, wired_link_view, WIRED, LINK_VIEW, AdwBin)
+
+GtkWidget *wired_link_view_new(NMDevice *device);
+
+G_END_DECLS
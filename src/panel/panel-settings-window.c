@@ -18,6 +18,7 @@
 
 #include "settings-config.h"
 #include "panel-settings-window.h"
+#include "settings-keys.h"
 
 struct _PanelSettingsWindow
 {
@@ -31,11 +32,24 @@ struct _PanelSettingsWindow
 
 G_DEFINE_TYPE(PanelSettingsWindow, panel_settings_window, ADW_TYPE_NAVIGATION_PAGE)
 
+static void
+panel_settings_window_dispose(GObject *object)
+{
+  PanelSettingsWindow *self = PANEL_SETTINGS_WINDOW(object);
+
+  g_clear_object(&self->panel_settings);
+
+  G_OBJECT_CLASS(panel_settings_window_parent_class)->dispose(object);
+}
+
 static void
 panel_settings_window_class_init(PanelSettingsWindowClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
   GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
 
+  object_class->dispose = panel_settings_window_dispose;
+
   gtk_widget_class_set_template_from_resource(widget_class, "/com/plenjos/Settings/panel/panel-settings-window.ui");
   gtk_widget_class_bind_template_child(widget_class, PanelSettingsWindow, panel_settings_preferences_page);
   gtk_widget_class_bind_template_child(widget_class, PanelSettingsWindow, panel_style_combo_row);
@@ -44,20 +58,18 @@ panel_settings_window_class_init(PanelSettingsWindowClass *klass)
 static void on_panel_style_selected(AdwComboRow *row, gpointer *idk, PanelSettingsWindow *self) {
   guint item = adw_combo_row_get_selected(row);
 
-  if (item == 1) {
-    g_settings_set_string(self->panel_settings, "color-scheme", "prefer-light");
-  } else if (item == 2) {
-    g_settings_set_string(self->panel_settings, "color-scheme", "prefer-dark");
-  } else {
-    g_settings_set_string(self->panel_settings, "color-scheme", "default");
+  if (item >= g_strv_length((char **)settings_keys_color_schemes)) {
+    item = 0;
   }
+
+  g_settings_set_string(self->panel_settings, "color-scheme", settings_keys_color_schemes[item]);
 }
 
 static void panel_settings_window_init(PanelSettingsWindow *self)
 {
   gtk_widget_init_template(GTK_WIDGET(self));
 
-  self->panel_settings = g_settings_new("com.plenjos.shell.panel");
+  self->panel_settings = g_settings_new(SETTINGS_KEYS_PANEL_SCHEMA);
 
   g_signal_connect(self->panel_style_combo_row, "notify::selected", G_CALLBACK(on_panel_style_selected), self);
 }
@@ -0,0 +1,322 @@
+/* settings-cli.c
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* plenjos-settings-cli: reads and writes the keys the settings window
+ * writes, for provisioning scripts. It only links GIO and dconf, so it
+ * starts in a few milliseconds, and applies a whole batch in one dconf
+ * transaction, so either every assignment is written or none is.
+ */
+
+#include <dconf.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "settings-config.h"
+#include "settings-keys.h"
+
+static void
+print_usage(FILE *stream)
+{
+  fprintf(stream,
+          "Usage:\n"
+          "  plenjos-settings-cli get SCHEMA KEY\n"
+          "  plenjos-settings-cli set SCHEMA KEY VALUE [SCHEMA KEY VALUE]...\n"
+          "  plenjos-settings-cli set -      Read \"SCHEMA KEY VALUE\" lines from stdin\n"
+          "  plenjos-settings-cli list       List the keys that can be set\n"
+          "\n"
+          "VALUE is in GVariant text format. Strings may be given without quotes.\n");
+}
+
+/* Resolves a supported key to its dconf path */
+static char *
+lookup_key(const char *schema_id, const char *key_name, const SettingsKey **key, GSettingsSchemaKey **schema_key, GError **error)
+{
+  GSettingsSchemaSource *source = g_settings_schema_source_get_default();
+  GSettingsSchema *schema;
+  const char *path;
+  char *full_path;
+
+  *key = settings_keys_lookup(schema_id, key_name);
+  if (!*key)
+  {
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "%s %s is not a supported key", schema_id, key_name);
+    return NULL;
+  }
+
+  schema = source ? g_settings_schema_source_lookup(source, schema_id, TRUE) : NULL;
+  if (!schema)
+  {
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "Schema %s is not installed", schema_id);
+    return NULL;
+  }
+
+  path = g_settings_schema_get_path(schema);
+  if (!path || !g_settings_schema_has_key(schema, key_name))
+  {
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "Schema %s has no key %s", schema_id, key_name);
+    g_settings_schema_unref(schema);
+    return NULL;
+  }
+
+  *schema_key = g_settings_schema_get_key(schema, key_name);
+  full_path = g_strconcat(path, key_name, NULL);
+
+  g_settings_schema_unref(schema);
+
+  return full_path;
+}
+
+static GVariant *
+parse_value(GSettingsSchemaKey *schema_key, const char *text, GError **error)
+{
+  const GVariantType *type = g_settings_schema_key_get_value_type(schema_key);
+  GVariant *value = g_variant_parse(type, text, NULL, NULL, NULL);
+
+  /* Let `color-scheme prefer-dark` through without shell-quoted quotes */
+  if (!value && g_variant_type_equal(type, G_VARIANT_TYPE_STRING))
+    value = g_variant_new_string(text);
+
+  if (!value)
+  {
+    char *type_string = g_variant_type_dup_string(type);
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "\"%s\" is not a valid value of type %s", text, type_string);
+    g_free(type_string);
+    return NULL;
+  }
+
+  g_variant_ref_sink(value);
+
+  if (!g_settings_schema_key_range_check(schema_key, value))
+  {
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "\"%s\" is out of range for %s", text, g_settings_schema_key_get_name(schema_key));
+    g_variant_unref(value);
+    return NULL;
+  }
+
+  return value;
+}
+
+/* Validates one assignment and adds it to the changeset */
+static gboolean
+add_assignment(DConfChangeset *changeset, const char *schema_id, const char *key_name, const char *text, GError **error)
+{
+  const SettingsKey *key;
+  GSettingsSchemaKey *schema_key = NULL;
+  GVariant *value;
+  char *path;
+  gboolean ret = FALSE;
+
+  path = lookup_key(schema_id, key_name, &key, &schema_key, error);
+  if (!path)
+    return FALSE;
+
+  value = parse_value(schema_key, text, error);
+  if (value && settings_keys_validate(key, value, error))
+  {
+    dconf_changeset_set(changeset, path, value);
+    ret = TRUE;
+  }
+
+  g_clear_pointer(&value, g_variant_unref);
+  g_settings_schema_key_unref(schema_key);
+  g_free(path);
+
+  return ret;
+}
+
+static gboolean
+read_assignments(DConfChangeset *changeset, GError **error)
+{
+  char line[4096];
+  int line_number = 0;
+
+  while (fgets(line, sizeof(line), stdin))
+  {
+    char **argv = NULL;
+    int argc = 0;
+    GError *parse_error = NULL;
+    gboolean ok;
+
+    line_number++;
+    g_strstrip(line);
+
+    if (!*line || *line == '#')
+      continue;
+
+    /* Shell-style quoting so paths with spaces can be given */
+    if (!g_shell_parse_argv(line, &argc, &argv, &parse_error) || argc != 3)
+    {
+      g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "stdin:%d: expected SCHEMA KEY VALUE", line_number);
+      g_clear_error(&parse_error);
+      g_strfreev(argv);
+      return FALSE;
+    }
+
+    ok = add_assignment(changeset, argv[0], argv[1], argv[2], error);
+    g_strfreev(argv);
+
+    if (!ok)
+    {
+      g_prefix_error(error, "stdin:%d: ", line_number);
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static int
+do_set(int argc, char *argv[])
+{
+  DConfChangeset *changeset = dconf_changeset_new();
+  DConfClient *client;
+  GError *error = NULL;
+  int ret = 1;
+
+  if (argc == 1 && !strcmp(argv[0], "-"))
+  {
+    if (!read_assignments(changeset, &error))
+      goto out;
+  }
+  else if (argc > 0 && argc % 3 == 0)
+  {
+    for (int i = 0; i < argc; i += 3)
+    {
+      if (!add_assignment(changeset, argv[i], argv[i + 1], argv[i + 2], &error))
+        goto out;
+    }
+  }
+  else
+  {
+    print_usage(stderr);
+    dconf_changeset_unref(changeset);
+    return 2;
+  }
+
+  if (dconf_changeset_is_empty(changeset))
+  {
+    ret = 0;
+    goto out;
+  }
+
+  /* Nothing has been written yet, so a bad line above leaves the old values */
+  client = dconf_client_new();
+  if (dconf_client_change_sync(client, changeset, NULL, NULL, &error))
+    ret = 0;
+  g_object_unref(client);
+
+out:
+  if (error)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+  }
+  dconf_changeset_unref(changeset);
+
+  return ret;
+}
+
+static int
+do_get(int argc, char *argv[])
+{
+  const SettingsKey *key;
+  GSettingsSchemaKey *schema_key = NULL;
+  DConfClient *client;
+  GVariant *value;
+  GError *error = NULL;
+  char *path, *printed;
+
+  if (argc != 2)
+  {
+    print_usage(stderr);
+    return 2;
+  }
+
+  path = lookup_key(argv[0], argv[1], &key, &schema_key, &error);
+  if (!path)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return 1;
+  }
+
+  client = dconf_client_new();
+  value = dconf_client_read(client, path);
+  if (!value)
+    value = g_settings_schema_key_get_default_value(schema_key);
+
+  printed = g_variant_print(value, FALSE);
+  printf("%s\n", printed);
+
+  g_free(printed);
+  g_variant_unref(value);
+  g_object_unref(client);
+  g_settings_schema_key_unref(schema_key);
+  g_free(path);
+
+  return 0;
+}
+
+static int
+do_list(void)
+{
+  guint n_keys;
+  const SettingsKey *keys = settings_keys_get(&n_keys);
+
+  for (guint i = 0; i < n_keys; i++)
+  {
+    printf("%s %s", keys[i].schema, keys[i].key);
+
+    if (keys[i].choices)
+    {
+      char *choices = g_strjoinv("|", (char **)keys[i].choices);
+      printf(" %s", choices);
+      g_free(choices);
+    }
+
+    printf("\n");
+  }
+
+  return 0;
+}
+
+int main(int argc,
+         char *argv[])
+{
+  if (argc < 2)
+  {
+    print_usage(stderr);
+    return 2;
+  }
+
+  if (!strcmp(argv[1], "set"))
+    return do_set(argc - 2, argv + 2);
+  if (!strcmp(argv[1], "get"))
+    return do_get(argc - 2, argv + 2);
+  if (!strcmp(argv[1], "list"))
+    return do_list();
+
+  if (!strcmp(argv[1], "--help") || !strcmp(argv[1], "-h"))
+  {
+    print_usage(stdout);
+    return 0;
+  }
+
+  print_usage(stderr);
+  return 2;
+}
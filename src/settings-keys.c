@@ -0,0 +1,90 @@
+/* settings-keys.c
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "settings-config.h"
+#include "settings-keys.h"
+
+const char *const settings_keys_color_schemes[] = {
+    "default",
+    "prefer-light",
+    "prefer-dark",
+    NULL};
+
+static gboolean
+validate_background(GVariant *value, GError **error)
+{
+  const char *path = g_variant_get_string(value, NULL);
+
+  /* The file chooser always hands us an absolute local path */
+  if (!g_path_is_absolute(path))
+  {
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Background \"%s\" is not an absolute path", path);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static const SettingsKey settings_keys[] = {
+    {SETTINGS_KEYS_INTERFACE_SCHEMA, "color-scheme", settings_keys_color_schemes, NULL},
+    {SETTINGS_KEYS_DESKTOP_SCHEMA, "background", NULL, validate_background},
+    {SETTINGS_KEYS_PANEL_SCHEMA, "color-scheme", settings_keys_color_schemes, NULL},
+};
+
+const SettingsKey *settings_keys_get(guint *n_keys)
+{
+  *n_keys = G_N_ELEMENTS(settings_keys);
+
+  return settings_keys;
+}
+
+const SettingsKey *settings_keys_lookup(const char *schema, const char *key)
+{
+  for (guint i = 0; i < G_N_ELEMENTS(settings_keys); i++)
+  {
+    if (!g_strcmp0(settings_keys[i].schema, schema) && !g_strcmp0(settings_keys[i].key, key))
+      return &settings_keys[i];
+  }
+
+  return NULL;
+}
+
+gboolean settings_keys_validate(const SettingsKey *key, GVariant *value, GError **error)
+{
+  if (key->choices)
+  {
+    if (!g_variant_is_of_type(value, G_VARIANT_TYPE_STRING) ||
+        !g_strv_contains((const char *const *)key->choices, g_variant_get_string(value, NULL)))
+    {
+      char *allowed = g_strjoinv(", ", (char **)key->choices);
+      char *printed = g_variant_print(value, FALSE);
+
+      g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                  "%s %s must be one of %s, not %s", key->schema, key->key, allowed, printed);
+
+      g_free(printed);
+      g_free(allowed);
+      return FALSE;
+    }
+  }
+
+  if (key->validate)
+    return key->validate(value, error);
+
+  return TRUE;
+}
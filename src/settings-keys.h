@@ -0,0 +1,52 @@
+/* settings-keys.h
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* The keys the settings pages write, shared with plenjos-settings-cli so
+ * both accept exactly the same values. This must not depend on GTK.
+ */
+
+#define SETTINGS_KEYS_INTERFACE_SCHEMA "org.gnome.desktop.interface"
+#define SETTINGS_KEYS_DESKTOP_SCHEMA "com.plenjos.shell.desktop"
+#define SETTINGS_KEYS_PANEL_SCHEMA "com.plenjos.shell.panel"
+
+/* In the order of the theme combo rows */
+extern const char *const settings_keys_color_schemes[];
+
+typedef struct SettingsKey
+{
+  const char *schema;
+  const char *key;
+
+  /* Allowed string values, or NULL for any */
+  const char *const *choices;
+  /* Further checks on top of the schema's own, or NULL */
+  gboolean (*validate)(GVariant *value, GError **error);
+} SettingsKey;
+
+const SettingsKey *settings_keys_get(guint *n_keys);
+const SettingsKey *settings_keys_lookup(const char *schema, const char *key);
+
+gboolean settings_keys_validate(const SettingsKey *key, GVariant *value, GError **error);
+
+G_END_DECLS
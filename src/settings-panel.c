@@ -0,0 +1,137 @@
+/* settings-panel.c
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "settings-config.h"
+#include "settings-panel.h"
+
+#include "network/network-settings-window.h"
+#include "display/display-settings-window.h"
+#include "appearance/appearance-settings-window.h"
+#include "panel/panel-settings-window.h"
+
+#include <gnome-bluetooth-3.0/bluetooth-settings-widget.h>
+
+static GtkWidget *create_network_panel(void)
+{
+  return g_object_new(NETWORK_SETTINGS_TYPE_WINDOW, NULL);
+}
+
+static GtkWidget *create_bluetooth_panel(void)
+{
+  GtkWidget *bluetooth_settings = bluetooth_settings_widget_new();
+
+  GtkBox *bluetooth_settings_box = GTK_BOX(gtk_box_new(GTK_ORIENTATION_VERTICAL, 0));
+
+  gtk_box_append(bluetooth_settings_box, adw_header_bar_new());
+  gtk_box_append(bluetooth_settings_box, bluetooth_settings);
+
+  return GTK_WIDGET(adw_navigation_page_new(GTK_WIDGET(bluetooth_settings_box), "Bluetooth"));
+}
+
+static GtkWidget *create_display_panel(void)
+{
+  return g_object_new(DISPLAY_SETTINGS_TYPE_WINDOW, NULL);
+}
+
+static GtkWidget *create_appearance_panel(void)
+{
+  return g_object_new(APPEARANCE_SETTINGS_TYPE_WINDOW, NULL);
+}
+
+static GtkWidget *create_panel_panel(void)
+{
+  return g_object_new(PANEL_SETTINGS_TYPE_WINDOW, NULL);
+}
+
+/* Sidebar order */
+static const SettingsPanel settings_panels[] = {
+    {"Network", "Network", "preferences-system-network", FALSE, create_network_panel},
+    {"Bluetooth", "Bluetooth", "bluetooth-active", FALSE, create_bluetooth_panel},
+    {"Displays", "Displays", "preferences-desktop-display", TRUE, create_display_panel},
+    {"Appearance", "Appearance", "preferences-desktop-theme", FALSE, create_appearance_panel},
+    {"Panel", "Panel", "panel", FALSE, create_panel_panel},
+};
+
+const SettingsPanel *settings_panels_get(guint *n_panels)
+{
+  *n_panels = G_N_ELEMENTS(settings_panels);
+
+  return settings_panels;
+}
+
+const SettingsPanel *settings_panels_lookup(const char *id)
+{
+  g_return_val_if_fail(id != NULL, NULL);
+
+  for (guint i = 0; i < G_N_ELEMENTS(settings_panels); i++)
+  {
+    if (!g_ascii_strcasecmp(settings_panels[i].id, id))
+      return &settings_panels[i];
+  }
+
+  return NULL;
+}
+
+guint settings_panels_get_position(const SettingsPanel *panel)
+{
+  g_return_val_if_fail(panel >= settings_panels && panel < settings_panels + G_N_ELEMENTS(settings_panels), GTK_INVALID_LIST_POSITION);
+
+  return panel - settings_panels;
+}
+
+struct _SettingsPanelItem
+{
+  GObject parent_instance;
+
+  const SettingsPanel *panel;
+};
+
+G_DEFINE_TYPE(SettingsPanelItem, settings_panel_item, G_TYPE_OBJECT)
+
+static void
+settings_panel_item_class_init(SettingsPanelItemClass *klass)
+{
+}
+
+static void
+settings_panel_item_init(SettingsPanelItem *self)
+{
+}
+
+const SettingsPanel *settings_panel_item_get_panel(SettingsPanelItem *self)
+{
+  g_return_val_if_fail(SETTINGS_IS_PANEL_ITEM(self), NULL);
+
+  return self->panel;
+}
+
+GListModel *settings_panels_create_model(void)
+{
+  GListStore *store = g_list_store_new(SETTINGS_TYPE_PANEL_ITEM);
+
+  for (guint i = 0; i < G_N_ELEMENTS(settings_panels); i++)
+  {
+    SettingsPanelItem *item = g_object_new(SETTINGS_TYPE_PANEL_ITEM, NULL);
+    item->panel = &settings_panels[i];
+
+    g_list_store_append(store, item);
+    g_object_unref(item);
+  }
+
+  return G_LIST_MODEL(store);
+}
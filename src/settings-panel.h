@@ -0,0 +1,59 @@
+/* settings-panel.h
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+#include <adwaita.h>
+
+G_BEGIN_DECLS
+
+typedef GtkWidget *(*SettingsPanelFactory)(void);
+
+/* Describes one page of the settings window. The sidebar is built from
+ * these, and the page itself is only created (through `create`) the
+ * first time it is needed.
+ */
+typedef struct SettingsPanel
+{
+  const char *id;
+  const char *title;
+  const char *icon_name;
+
+  /* Leave a gap above this panel in the sidebar */
+  gboolean group_start;
+
+  SettingsPanelFactory create;
+} SettingsPanel;
+
+const SettingsPanel *settings_panels_get(guint *n_panels);
+const SettingsPanel *settings_panels_lookup(const char *id);
+guint settings_panels_get_position(const SettingsPanel *panel);
+
+/* List model item wrapping one registry entry, for the sidebar */
+#define SETTINGS_TYPE_PANEL_ITEM (settings_panel_item_get_type())
+
+G_DECLARE_FINAL_TYPE(SettingsPanelItem, settings_panel_item, SETTINGS, PANEL_ITEM, GObject)
+
+const SettingsPanel *settings_panel_item_get_panel(SettingsPanelItem *self);
+
+/* Returns a new model with one SettingsPanelItem per panel, in registry
+ * order, so positions match settings_panels_get_position(). */
+GListModel *settings_panels_create_model(void);
+
+G_END_DECLS
@@ -0,0 +1,325 @@
+/* settings-profiler.c
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "settings-config.h"
+#include "settings-profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#define PROFILE_OPTION "--profile-startup"
+#define PROFILE_ENV "PLENJOS_SETTINGS_PROFILE_STARTUP"
+
+typedef struct ProfilerPhase
+{
+  char *name;
+  gint64 start;
+  /* -1 while the phase is still running */
+  gint64 end;
+} ProfilerPhase;
+
+typedef struct ProfilerSample
+{
+  guint count;
+  gint64 total;
+  gint64 max;
+} ProfilerSample;
+
+static struct
+{
+  gboolean enabled;
+  gboolean written;
+  gboolean first_frame;
+
+  /* NULL for stderr */
+  char *output;
+
+  gint64 start_time;
+  GArray *phases;
+  guint outstanding;
+
+  /* Name → ProfilerSample, kept until exit */
+  GHashTable *samples;
+} profiler;
+
+static void
+profiler_set_output(const char *output)
+{
+  profiler.enabled = TRUE;
+
+  g_free(profiler.output);
+  profiler.output = NULL;
+
+  if (output && *output && strcmp(output, "1") != 0 && strcmp(output, "stderr") != 0)
+    profiler.output = g_strdup(output);
+}
+
+void settings_profiler_init(int *argc, char ***argv)
+{
+  const char *env = g_getenv(PROFILE_ENV);
+  int i, j;
+
+  profiler.start_time = g_get_monotonic_time();
+
+  if (env && *env && strcmp(env, "0") != 0)
+    profiler_set_output(env);
+
+  /* Strip our option before GApplication sees it */
+  for (i = 1, j = 1; i < *argc; i++)
+  {
+    char *arg = (*argv)[i];
+
+    if (!strcmp(arg, PROFILE_OPTION))
+      profiler_set_output(NULL);
+    else if (g_str_has_prefix(arg, PROFILE_OPTION "="))
+      profiler_set_output(arg + strlen(PROFILE_OPTION "="));
+    else
+      (*argv)[j++] = arg;
+  }
+  *argc = j;
+  (*argv)[j] = NULL;
+
+  if (!profiler.enabled)
+    return;
+
+  profiler.phases = g_array_new(FALSE, TRUE, sizeof(ProfilerPhase));
+  profiler.samples = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+  settings_profiler_mark("main");
+}
+
+gboolean settings_profiler_is_enabled(void)
+{
+  return profiler.enabled && !profiler.written;
+}
+
+gint64 settings_profiler_get_start_time(void)
+{
+  return profiler.start_time;
+}
+
+static void
+profiler_add(const char *phase, gint64 start, gint64 end)
+{
+  ProfilerPhase entry = {g_strdup(phase), start - profiler.start_time, end < 0 ? -1 : end - profiler.start_time};
+
+  g_array_append_val(profiler.phases, entry);
+}
+
+static void
+profiler_maybe_write(void)
+{
+  if (profiler.first_frame && profiler.outstanding == 0)
+    settings_profiler_finish();
+}
+
+void settings_profiler_mark(const char *phase)
+{
+  if (!settings_profiler_is_enabled())
+    return;
+
+  gint64 now = g_get_monotonic_time();
+  profiler_add(phase, now, now);
+}
+
+void settings_profiler_begin(const char *phase)
+{
+  if (!settings_profiler_is_enabled())
+    return;
+
+  profiler_add(phase, g_get_monotonic_time(), -1);
+  profiler.outstanding++;
+}
+
+void settings_profiler_end(const char *phase)
+{
+  if (!settings_profiler_is_enabled())
+    return;
+
+  for (guint i = profiler.phases->len; i > 0; i--)
+  {
+    ProfilerPhase *entry = &g_array_index(profiler.phases, ProfilerPhase, i - 1);
+
+    if (entry->end < 0 && !strcmp(entry->name, phase))
+    {
+      entry->end = g_get_monotonic_time() - profiler.start_time;
+      profiler.outstanding--;
+      profiler_maybe_write();
+      return;
+    }
+  }
+
+  g_warning("Profiler phase \"%s\" ended without being started", phase);
+}
+
+void settings_profiler_first_frame(void)
+{
+  if (!settings_profiler_is_enabled() || profiler.first_frame)
+    return;
+
+  settings_profiler_mark("first-frame");
+  profiler.first_frame = TRUE;
+  profiler_maybe_write();
+}
+
+gboolean settings_profiler_is_sampling(void)
+{
+  return profiler.samples != NULL;
+}
+
+void settings_profiler_sample(const char *name, gint64 start_time)
+{
+  ProfilerSample *sample;
+  gint64 duration;
+
+  if (!settings_profiler_is_sampling())
+    return;
+
+  duration = g_get_monotonic_time() - start_time;
+
+  sample = g_hash_table_lookup(profiler.samples, name);
+  if (!sample)
+  {
+    sample = g_new0(ProfilerSample, 1);
+    g_hash_table_insert(profiler.samples, g_strdup(name), sample);
+  }
+
+  sample->count++;
+  sample->total += duration;
+  sample->max = MAX(sample->max, duration);
+}
+
+static void
+write_report(const char *path, GString *json)
+{
+  if (path)
+  {
+    GError *error = NULL;
+
+    if (!g_file_set_contents(path, json->str, json->len, &error))
+    {
+      fprintf(stderr, "Failed to write profile. %s.\n", error->message);
+      g_error_free(error);
+    }
+  }
+  else
+  {
+    fputs(json->str, stderr);
+  }
+  fflush(stderr);
+}
+
+static void
+append_json_string(GString *json, const char *str)
+{
+  g_string_append_c(json, '"');
+
+  for (const char *c = str; *c; c++)
+  {
+    if (*c == '"' || *c == '\\')
+      g_string_append_printf(json, "\\%c", *c);
+    else if ((guchar)*c < 0x20)
+      g_string_append_printf(json, "\\u%04x", (guchar)*c);
+    else
+      g_string_append_c(json, *c);
+  }
+
+  g_string_append_c(json, '"');
+}
+
+void settings_profiler_finish(void)
+{
+  if (!settings_profiler_is_enabled())
+    return;
+
+  GString *json = g_string_new("{\n  \"version\": ");
+  append_json_string(json, PACKAGE_VERSION);
+  g_string_append(json, ",\n  \"unit\": \"us\",\n  \"phases\": [");
+
+  for (guint i = 0; i < profiler.phases->len; i++)
+  {
+    ProfilerPhase *entry = &g_array_index(profiler.phases, ProfilerPhase, i);
+
+    g_string_append(json, i ? ",\n    {\"name\": " : "\n    {\"name\": ");
+    append_json_string(json, entry->name);
+    g_string_append_printf(json, ", \"start\": %" G_GINT64_FORMAT, entry->start);
+
+    /* Phases still running at exit have no duration */
+    if (entry->end >= 0)
+      g_string_append_printf(json, ", \"duration\": %" G_GINT64_FORMAT "}", entry->end - entry->start);
+    else
+      g_string_append(json, ", \"duration\": null}");
+
+    g_free(entry->name);
+  }
+
+  g_string_append(json, "\n  ]\n}\n");
+
+  write_report(profiler.output, json);
+
+  g_string_free(json, TRUE);
+  g_array_free(profiler.phases, TRUE);
+  profiler.phases = NULL;
+
+  profiler.written = TRUE;
+}
+
+void settings_profiler_finish_samples(void)
+{
+  GHashTableIter iter;
+  gpointer name, value;
+  gboolean first = TRUE;
+  struct rusage usage;
+  char *path;
+
+  if (!settings_profiler_is_sampling())
+    return;
+
+  GString *json = g_string_new("{\n  \"version\": ");
+  append_json_string(json, PACKAGE_VERSION);
+  g_string_append(json, ",\n  \"unit\": \"us\",");
+
+  /* Linux reports it in KiB */
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    g_string_append_printf(json, "\n  \"peak_rss_kb\": %ld,", usage.ru_maxrss);
+
+  g_string_append(json, "\n  \"samples\": [");
+
+  g_hash_table_iter_init(&iter, profiler.samples);
+  while (g_hash_table_iter_next(&iter, &name, &value))
+  {
+    ProfilerSample *sample = value;
+
+    g_string_append(json, first ? "\n    {\"name\": " : ",\n    {\"name\": ");
+    append_json_string(json, name);
+    g_string_append_printf(json, ", \"count\": %u, \"total\": %" G_GINT64_FORMAT ", \"max\": %" G_GINT64_FORMAT "}",
+                           sample->count, sample->total, sample->max);
+    first = FALSE;
+  }
+
+  g_string_append(json, "\n  ]\n}\n");
+
+  path = profiler.output ? g_strconcat(profiler.output, ".samples.json", NULL) : NULL;
+  write_report(path, json);
+
+  g_free(path);
+  g_string_free(json, TRUE);
+  g_clear_pointer(&profiler.samples, g_hash_table_unref);
+  g_clear_pointer(&profiler.output, g_free);
+}
@@ -0,0 +1,57 @@
+/* settings-profiler.h
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Startup profiling, enabled with --profile-startup[=FILE] or the
+ * PLENJOS_SETTINGS_PROFILE_STARTUP environment variable ("1" for stderr,
+ * anything else is taken as a file name).
+ *
+ * Phases are timed relative to settings_profiler_init(). The report is
+ * written as JSON once the first frame has been painted and every phase
+ * that was begun has ended, or at exit, whichever comes first. All of
+ * these are no-ops when profiling is disabled.
+ *
+ * Work that keeps happening after startup, such as Wi-Fi list updates,
+ * is recorded with settings_profiler_sample() instead. Samples are
+ * summed up per name (count, total, max) and written at exit, to
+ * FILE.samples.json or to stderr, along with the peak resident set size.
+ * tests/wifi-benchmark.py reads them.
+ */
+void settings_profiler_init(int *argc, char ***argv);
+gboolean settings_profiler_is_enabled(void);
+/* Monotonic time of settings_profiler_init(), for samples measured
+ * from process start */
+gint64 settings_profiler_get_start_time(void);
+
+void settings_profiler_mark(const char *phase);
+void settings_profiler_begin(const char *phase);
+void settings_profiler_end(const char *phase);
+
+void settings_profiler_first_frame(void);
+void settings_profiler_finish(void);
+
+gboolean settings_profiler_is_sampling(void);
+void settings_profiler_sample(const char *name, gint64 start_time);
+void settings_profiler_finish_samples(void);
+
+G_END_DECLS
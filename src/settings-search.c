@@ -0,0 +1,376 @@
+/* settings-search.c
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "settings-config.h"
+#include "settings-search.h"
+
+#include <string.h>
+
+/* See build-search-index.py for the layout */
+#define INDEX_RESOURCE "/com/plenjos/Settings/search-index.bin"
+#define INDEX_MAGIC "PSI1"
+#define INDEX_HEADER_SIZE 20
+
+typedef struct SearchIndex
+{
+  GBytes *bytes;
+
+  guint32 n_entries;
+  guint32 n_words;
+  guint32 n_trigrams;
+  guint32 n_postings;
+
+  const guint32 *entries;
+  const guint32 *words;
+  const guint32 *trigrams;
+  const guint32 *postings;
+
+  const char *strings;
+  gsize strings_size;
+
+  /* Per-entry count of query words matched so far, reset after each query */
+  guint16 *matched;
+} SearchIndex;
+
+struct _SettingsSearchResult
+{
+  GObject parent_instance;
+
+  /* Point into the index, which is never freed */
+  const char *panel_id;
+  const char *row_id;
+  const char *title;
+};
+
+G_DEFINE_TYPE(SettingsSearchResult, settings_search_result, G_TYPE_OBJECT)
+
+static void
+settings_search_result_class_init(SettingsSearchResultClass *klass)
+{
+}
+
+static void
+settings_search_result_init(SettingsSearchResult *self)
+{
+}
+
+const char *settings_search_result_get_panel_id(SettingsSearchResult *self)
+{
+  g_return_val_if_fail(SETTINGS_IS_SEARCH_RESULT(self), NULL);
+
+  return self->panel_id;
+}
+
+const char *settings_search_result_get_row_id(SettingsSearchResult *self)
+{
+  g_return_val_if_fail(SETTINGS_IS_SEARCH_RESULT(self), NULL);
+
+  return self->row_id;
+}
+
+const char *settings_search_result_get_title(SettingsSearchResult *self)
+{
+  g_return_val_if_fail(SETTINGS_IS_SEARCH_RESULT(self), NULL);
+
+  return self->title;
+}
+
+#define U32(ptr, i) GUINT32_FROM_LE((ptr)[i])
+
+static const char *
+index_string(SearchIndex *index, guint32 offset)
+{
+  return offset < index->strings_size ? index->strings + offset : "";
+}
+
+static gboolean
+index_load(SearchIndex *index)
+{
+  GError *error = NULL;
+  const guint8 *data;
+  gsize size, tables_size;
+
+  index->bytes = g_resources_lookup_data(INDEX_RESOURCE, G_RESOURCE_LOOKUP_FLAGS_NONE, &error);
+  if (!index->bytes)
+  {
+    g_warning("Failed to load the search index. %s.", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  data = g_bytes_get_data(index->bytes, &size);
+  if (size < INDEX_HEADER_SIZE || memcmp(data, INDEX_MAGIC, 4) != 0)
+    goto invalid;
+
+  const guint32 *header = (const guint32 *)(data + 4);
+  index->n_entries = U32(header, 0);
+  index->n_words = U32(header, 1);
+  index->n_trigrams = U32(header, 2);
+  index->n_postings = U32(header, 3);
+
+  tables_size = ((gsize)index->n_entries * 4 + (gsize)index->n_words * 2 + (gsize)index->n_trigrams * 3 + index->n_postings) * sizeof(guint32);
+  if (index->n_entries > G_MAXUINT16 || tables_size > size - INDEX_HEADER_SIZE)
+    goto invalid;
+
+  index->entries = (const guint32 *)(data + INDEX_HEADER_SIZE);
+  index->words = index->entries + index->n_entries * 4;
+  index->trigrams = index->words + index->n_words * 2;
+  index->postings = index->trigrams + index->n_trigrams * 3;
+  index->strings = (const char *)(index->postings + index->n_postings);
+  index->strings_size = size - INDEX_HEADER_SIZE - tables_size;
+
+  /* Strings are read with plain C string functions, so the pool has to end
+   * in a NUL and every entry a lookup can land on has to be in range. */
+  if (index->strings_size == 0 || index->strings[index->strings_size - 1] != '\0')
+    goto invalid;
+
+  for (guint32 i = 0; i < index->n_words; i++)
+  {
+    if (U32(index->words, i * 2 + 1) >= index->n_entries)
+      goto invalid;
+  }
+
+  for (guint32 i = 0; i < index->n_trigrams; i++)
+  {
+    if ((guint64)U32(index->trigrams, i * 3 + 1) + U32(index->trigrams, i * 3 + 2) > index->n_postings)
+      goto invalid;
+  }
+
+  for (guint32 i = 0; i < index->n_postings; i++)
+  {
+    if (U32(index->postings, i) >= index->n_entries)
+      goto invalid;
+  }
+
+  index->matched = g_new0(guint16, index->n_entries);
+
+  return TRUE;
+
+invalid:
+  g_warning("The search index is corrupt");
+  g_clear_pointer(&index->bytes, g_bytes_unref);
+  return FALSE;
+}
+
+static SearchIndex *
+get_index(void)
+{
+  static SearchIndex index;
+  static gsize loaded = 0;
+  static gboolean valid = FALSE;
+
+  if (g_once_init_enter(&loaded))
+  {
+    valid = index_load(&index);
+    g_once_init_leave(&loaded, 1);
+  }
+
+  return valid ? &index : NULL;
+}
+
+static const char *
+entry_field(SearchIndex *index, guint32 entry, guint field)
+{
+  return index_string(index, U32(index->entries, entry * 4 + field));
+}
+
+/* Moves an entry that matched every word before this one to the next
+ * round, and collects it if this was the last word. */
+static void
+match_entry(SearchIndex *index, guint32 entry, guint16 round, gboolean last, GArray *hits)
+{
+  if (index->matched[entry] != round)
+    return;
+
+  index->matched[entry] = round + 1;
+
+  if (last)
+    g_array_append_val(hits, entry);
+}
+
+static void
+match_prefix(SearchIndex *index, const char *word, guint16 round, gboolean last, GArray *hits)
+{
+  gsize len = strlen(word);
+  guint32 low = 0, high = index->n_words;
+
+  /* Lower bound of `word` in the sorted word table */
+  while (low < high)
+  {
+    guint32 mid = low + (high - low) / 2;
+
+    if (strcmp(index_string(index, U32(index->words, mid * 2)), word) < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  for (; low < index->n_words; low++)
+  {
+    if (strncmp(index_string(index, U32(index->words, low * 2)), word, len) != 0)
+      break;
+
+    match_entry(index, U32(index->words, low * 2 + 1), round, last, hits);
+  }
+}
+
+static gboolean
+find_trigram(SearchIndex *index, guint32 trigram, guint32 *first, guint32 *count)
+{
+  guint32 low = 0, high = index->n_trigrams;
+
+  while (low < high)
+  {
+    guint32 mid = low + (high - low) / 2;
+    guint32 key = U32(index->trigrams, mid * 3);
+
+    if (key == trigram)
+    {
+      *first = U32(index->trigrams, mid * 3 + 1);
+      *count = U32(index->trigrams, mid * 3 + 2);
+      return TRUE;
+    }
+
+    if (key < trigram)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return FALSE;
+}
+
+static void
+match_substring(SearchIndex *index, const char *word, guint16 round, gboolean last, GArray *hits)
+{
+  const guchar *w = (const guchar *)word;
+  guint32 first = 0, count = G_MAXUINT32;
+
+  /* Only the rarest trigram's postings are walked; the rest are implied by
+   * checking the entry text for the whole word. */
+  for (gsize i = 0; w[i + 2]; i++)
+  {
+    guint32 trigram_first, trigram_count;
+
+    if (!find_trigram(index, ((guint32)w[i] << 16) | ((guint32)w[i + 1] << 8) | w[i + 2], &trigram_first, &trigram_count))
+      return;
+
+    if (trigram_count < count)
+    {
+      first = trigram_first;
+      count = trigram_count;
+    }
+  }
+
+  for (guint32 i = first; i < first + count; i++)
+  {
+    guint32 entry = U32(index->postings, i);
+
+    if (index->matched[entry] == round && strstr(entry_field(index, entry, 3), word))
+      match_entry(index, entry, round, last, hits);
+  }
+}
+
+typedef struct
+{
+  SearchIndex *index;
+  const char *first_word;
+} RankData;
+
+static int
+compare_hits(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  RankData *data = user_data;
+  guint32 entry_a = *(const guint32 *)a;
+  guint32 entry_b = *(const guint32 *)b;
+  gsize len = strlen(data->first_word);
+
+  /* Titles starting with the query come first, then index order */
+  gboolean prefix_a = g_ascii_strncasecmp(entry_field(data->index, entry_a, 2), data->first_word, len) == 0;
+  gboolean prefix_b = g_ascii_strncasecmp(entry_field(data->index, entry_b, 2), data->first_word, len) == 0;
+
+  if (prefix_a != prefix_b)
+    return prefix_a ? -1 : 1;
+
+  return entry_a < entry_b ? -1 : entry_a > entry_b;
+}
+
+GPtrArray *settings_search_query(const char *query, guint max_results)
+{
+  GPtrArray *results = g_ptr_array_new_with_free_func(g_object_unref);
+  SearchIndex *index = get_index();
+  char **words;
+  guint n_words = 0;
+
+  if (!index || !query)
+    return results;
+
+  char *normalized = g_ascii_strdown(query, -1);
+  words = g_strsplit_set(normalized, " \t\n", -1);
+  g_free(normalized);
+
+  /* Drop the empty strings g_strsplit_set() leaves between separators */
+  for (guint i = 0; words[i]; i++)
+  {
+    if (*words[i])
+      words[n_words++] = words[i];
+    else
+      g_free(words[i]);
+  }
+  words[n_words] = NULL;
+
+  if (n_words == 0 || n_words >= G_MAXUINT16)
+  {
+    g_strfreev(words);
+    return results;
+  }
+
+  GArray *hits = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+  for (guint16 round = 0; round < n_words; round++)
+  {
+    gboolean last = round + 1 == n_words;
+
+    if (strlen(words[round]) < 3)
+      match_prefix(index, words[round], round, last, hits);
+    else
+      match_substring(index, words[round], round, last, hits);
+  }
+
+  RankData rank = {index, words[0]};
+  g_array_sort_with_data(hits, compare_hits, &rank);
+
+  for (guint i = 0; i < hits->len && i < max_results; i++)
+  {
+    guint32 entry = g_array_index(hits, guint32, i);
+    SettingsSearchResult *result = g_object_new(SETTINGS_TYPE_SEARCH_RESULT, NULL);
+
+    result->panel_id = entry_field(index, entry, 0);
+    result->row_id = entry_field(index, entry, 1);
+    result->title = entry_field(index, entry, 2);
+
+    g_ptr_array_add(results, result);
+  }
+
+  memset(index->matched, 0, index->n_entries * sizeof(guint16));
+
+  g_array_free(hits, TRUE);
+  g_strfreev(words);
+
+  return results;
+}
@@ -0,0 +1,40 @@
+/* settings-search.h
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define SETTINGS_TYPE_SEARCH_RESULT (settings_search_result_get_type())
+
+G_DECLARE_FINAL_TYPE(SettingsSearchResult, settings_search_result, SETTINGS, SEARCH_RESULT, GObject)
+
+const char *settings_search_result_get_panel_id(SettingsSearchResult *self);
+/* The row's id in its panel's UI file, or "" for rows built in code */
+const char *settings_search_result_get_row_id(SettingsSearchResult *self);
+const char *settings_search_result_get_title(SettingsSearchResult *self);
+
+/* Looks up every whitespace-separated word of `query` in the search index
+ * that is generated from the UI files at build time. No panels are
+ * built. Returns a new array of SettingsSearchResult, best matches first.
+ */
+GPtrArray *settings_search_query(const char *query, guint max_results);
+
+G_END_DECLS
@@ -18,153 +18,687 @@
 
 #include "settings-config.h"
 #include "settings-window.h"
+#include "settings-profiler.h"
+#include "settings-search.h"
+
+#define MAX_SEARCH_RESULTS 50
+
+/* What is kept of a panel while it isn't built, so that it comes back
+ * looking the way it was left. */
+typedef struct PanelState
+{
+  /* Monotonic time the built page was last hidden, 0 while visible */
+  gint64 hidden_since;
+
+  double scroll;
+  /* Row identified the same way as search results */
+  char *focus_row_id;
+  char *focus_row_title;
+} PanelState;
 
 struct _SettingsWindow
 {
   AdwApplicationWindow parent_instance;
 
   GtkBox *sidebar_box;
+  GtkListView *sidebar_list;
+  GtkSingleSelection *sidebar_selection;
   GtkStack *main_stack;
   AdwNavigationSplitView *split_view;
+
+  GtkSearchEntry *search_entry;
+  GtkStack *sidebar_stack;
+  GtkListView *search_results_list;
+  GListStore *search_results;
+
+  GSettings *settings;
+
+  /* Panels are built on first use; this walks the rest of them in idle
+   * time once the window has been drawn. */
+  guint prewarm_source;
+  guint prewarm_next;
+
+  /* Indexed by registry position */
+  PanelState *panel_states;
+  const SettingsPanel *visible_panel;
+  guint eviction_source;
+
+  /* Start of the frame being painted, while sampling frames */
+  gboolean sampling_frames;
+  gint64 frame_start;
 };
 
 G_DEFINE_TYPE(SettingsWindow, settings_window, ADW_TYPE_APPLICATION_WINDOW)
 
+static GtkWidget *
+find_row(GtkWidget *widget, const char *row_id, const char *title)
+{
+  if (ADW_IS_PREFERENCES_ROW(widget))
+  {
+    const char *id = gtk_buildable_get_buildable_id(GTK_BUILDABLE(widget));
+
+    if ((*row_id && !g_strcmp0(id, row_id)) || !g_strcmp0(adw_preferences_row_get_title(ADW_PREFERENCES_ROW(widget)), title))
+      return widget;
+  }
+
+  for (GtkWidget *child = gtk_widget_get_first_child(widget); child; child = gtk_widget_get_next_sibling(child))
+  {
+    GtkWidget *row = find_row(child, row_id, title);
+
+    if (row)
+      return row;
+  }
+
+  return NULL;
+}
+
+static GtkScrolledWindow *
+find_scrolled_window(GtkWidget *widget)
+{
+  if (GTK_IS_SCROLLED_WINDOW(widget))
+    return GTK_SCROLLED_WINDOW(widget);
+
+  for (GtkWidget *child = gtk_widget_get_first_child(widget); child; child = gtk_widget_get_next_sibling(child))
+  {
+    GtkScrolledWindow *scrolled = find_scrolled_window(child);
+
+    if (scrolled)
+      return scrolled;
+  }
+
+  return NULL;
+}
+
 static void
-settings_window_class_init(SettingsWindowClass *klass)
+on_restore_adjustment_changed(GtkAdjustment *adjustment, SettingsWindow *self)
 {
-  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+  GtkWidget *scrolled = g_object_get_data(G_OBJECT(adjustment), "settings-restore-page");
+  PanelState *state = g_object_get_data(G_OBJECT(adjustment), "settings-restore-state");
+  double page_size = gtk_adjustment_get_page_size(adjustment);
+
+  /* Wait until the page has been allocated. The content may fit without
+   * scrolling by then (the window was made taller), so don't wait for it
+   * to overflow; clamp instead. */
+  if (page_size <= 0)
+    return;
 
-  gtk_widget_class_set_template_from_resource(widget_class, "/com/plenjos/Settings/settings-window.ui");
-  gtk_widget_class_bind_template_child(widget_class, SettingsWindow, sidebar_box);
-  gtk_widget_class_bind_template_child(widget_class, SettingsWindow, main_stack);
-  gtk_widget_class_bind_template_child(widget_class, SettingsWindow, split_view);
+  g_signal_handlers_disconnect_by_func(adjustment, on_restore_adjustment_changed, self);
+
+  if (state->focus_row_id || state->focus_row_title)
+  {
+    GtkWidget *row = find_row(scrolled, state->focus_row_id ? state->focus_row_id : "", state->focus_row_title);
+
+    if (row)
+      gtk_widget_grab_focus(row);
+  }
+
+  gtk_adjustment_set_value(adjustment, CLAMP(state->scroll, 0, MAX(gtk_adjustment_get_upper(adjustment) - page_size, 0)));
 }
 
-void stack_switcher_set_halign_helper(GtkWidget *widget,
-                                      gpointer data)
+static void
+restore_panel_state(SettingsWindow *self, GtkWidget *page, PanelState *state)
 {
-  gtk_widget_set_halign(widget, GTK_ALIGN_START);
+  GtkScrolledWindow *scrolled = find_scrolled_window(page);
+
+  if (!scrolled || (state->scroll <= 0 && !state->focus_row_id && !state->focus_row_title))
+    return;
+
+  GtkAdjustment *adjustment = gtk_scrolled_window_get_vadjustment(scrolled);
+
+  g_object_set_data(G_OBJECT(adjustment), "settings-restore-page", scrolled);
+  g_object_set_data(G_OBJECT(adjustment), "settings-restore-state", state);
+  g_signal_connect_object(adjustment, "changed", G_CALLBACK(on_restore_adjustment_changed), self, 0);
 }
 
-void stack_switcher_set_halign(GtkWidget *widget,
-                               gpointer data)
+static void
+panel_state_clear(PanelState *state)
 {
-  // gtk_container_foreach (widget, stack_switcher_set_halign_helper, NULL);
+  state->hidden_since = 0;
+  state->scroll = 0;
+  g_clear_pointer(&state->focus_row_id, g_free);
+  g_clear_pointer(&state->focus_row_title, g_free);
+}
+
+static void schedule_eviction(SettingsWindow *self);
+
+static GtkWidget *
+settings_window_ensure_panel(SettingsWindow *self, const SettingsPanel *panel)
+{
+  GtkWidget *page = gtk_stack_get_child_by_name(self->main_stack, panel->id);
+
+  if (page)
+    return page;
+
+  char *phase = g_strconcat("panel:", panel->id, NULL);
+  settings_profiler_begin(phase);
+
+  page = panel->create();
+
+  settings_profiler_end(phase);
+  g_free(phase);
+
+  gtk_stack_add_titled(self->main_stack, page, panel->id, panel->title);
+
+  PanelState *state = &self->panel_states[settings_panels_get_position(panel)];
+
+  /* Coming back after being evicted */
+  restore_panel_state(self, page, state);
+
+  /* Prewarmed pages count as hidden until they are shown */
+  state->hidden_since = g_get_monotonic_time();
+  schedule_eviction(self);
+
+  return page;
+}
+
+static gboolean on_eviction_timeout(SettingsWindow *self);
+
+/* Arms the timer for the page that has been hidden the longest */
+static void
+schedule_eviction(SettingsWindow *self)
+{
+  guint timeout = g_settings_get_uint(self->settings, "page-eviction-timeout");
+  gint64 oldest = 0;
+  guint n_panels;
+  const SettingsPanel *panels = settings_panels_get(&n_panels);
+
+  g_clear_handle_id(&self->eviction_source, g_source_remove);
+
+  if (timeout == 0)
+    return;
+
+  for (guint i = 0; i < n_panels; i++)
+  {
+    gint64 hidden_since = self->panel_states[i].hidden_since;
+
+    if (hidden_since && (!oldest || hidden_since < oldest) && gtk_stack_get_child_by_name(self->main_stack, panels[i].id))
+      oldest = hidden_since;
+  }
+
+  if (!oldest)
+    return;
+
+  gint64 remaining = oldest + timeout * G_USEC_PER_SEC - g_get_monotonic_time();
+  guint seconds = remaining > 0 ? (guint)((remaining + G_USEC_PER_SEC - 1) / G_USEC_PER_SEC) : 0;
+
+  self->eviction_source = g_timeout_add_seconds(seconds, (GSourceFunc)on_eviction_timeout, self);
+}
+
+static void
+evict_panel(SettingsWindow *self, const SettingsPanel *panel, GtkWidget *page)
+{
+  PanelState *state = &self->panel_states[settings_panels_get_position(panel)];
+  GtkScrolledWindow *scrolled = find_scrolled_window(page);
+
+  state->scroll = scrolled ? gtk_adjustment_get_value(gtk_scrolled_window_get_vadjustment(scrolled)) : 0;
+  state->hidden_since = 0;
+
+  gtk_stack_remove(self->main_stack, page);
+}
+
+static gboolean
+on_eviction_timeout(SettingsWindow *self)
+{
+  guint timeout = g_settings_get_uint(self->settings, "page-eviction-timeout");
+  gint64 now = g_get_monotonic_time();
+  guint n_panels;
+  const SettingsPanel *panels = settings_panels_get(&n_panels);
+
+  self->eviction_source = 0;
+
+  for (guint i = 0; i < n_panels; i++)
+  {
+    gint64 hidden_since = self->panel_states[i].hidden_since;
+    GtkWidget *page;
+
+    if (!hidden_since || now - hidden_since < (gint64)timeout * G_USEC_PER_SEC)
+      continue;
+
+    page = gtk_stack_get_child_by_name(self->main_stack, panels[i].id);
+    if (page)
+      evict_panel(self, &panels[i], page);
+  }
+
+  schedule_eviction(self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+on_visible_child_changed(GtkStack *stack, GParamSpec *pspec, SettingsWindow *self)
+{
+  const char *name = gtk_stack_get_visible_child_name(stack);
+  const SettingsPanel *panel = name ? settings_panels_lookup(name) : NULL;
+
+  if (panel == self->visible_panel)
+    return;
+
+  if (self->visible_panel)
+    self->panel_states[settings_panels_get_position(self->visible_panel)].hidden_since = g_get_monotonic_time();
+
+  if (panel)
+    self->panel_states[settings_panels_get_position(panel)].hidden_since = 0;
+
+  self->visible_panel = panel;
+
+  schedule_eviction(self);
+}
+
+static void
+on_focus_widget_changed(SettingsWindow *self, GParamSpec *pspec, gpointer user_data)
+{
+  GtkWidget *focus = gtk_root_get_focus(GTK_ROOT(self));
+  GtkWidget *page = gtk_stack_get_visible_child(self->main_stack);
+  GtkWidget *row;
+
+  if (!self->visible_panel || !focus || !page || !gtk_widget_is_ancestor(focus, page))
+    return;
+
+  row = ADW_IS_PREFERENCES_ROW(focus) ? focus : gtk_widget_get_ancestor(focus, ADW_TYPE_PREFERENCES_ROW);
+  if (!row)
+    return;
+
+  /* Remembered now, because the stack drops the focus when it switches */
+  PanelState *state = &self->panel_states[settings_panels_get_position(self->visible_panel)];
+  const char *id = gtk_buildable_get_buildable_id(GTK_BUILDABLE(row));
+
+  g_free(state->focus_row_id);
+  g_free(state->focus_row_title);
+  state->focus_row_id = g_strdup(id);
+  state->focus_row_title = g_strdup(adw_preferences_row_get_title(ADW_PREFERENCES_ROW(row)));
+}
+
+static void
+settings_window_present_panel(SettingsWindow *self, const SettingsPanel *panel)
+{
+  settings_window_ensure_panel(self, panel);
+  gtk_stack_set_visible_child_name(self->main_stack, panel->id);
+
+  adw_navigation_split_view_set_show_content(self->split_view, TRUE);
+}
+
+void settings_window_show_panel(SettingsWindow *self, const char *id)
+{
+  const SettingsPanel *panel = settings_panels_lookup(id);
+
+  g_return_if_fail(panel != NULL);
+
+  guint position = settings_panels_get_position(panel);
+
+  /* Changing the selection presents the panel through on_sidebar_selected */
+  if (gtk_single_selection_get_selected(self->sidebar_selection) != position)
+    gtk_single_selection_set_selected(self->sidebar_selection, position);
+  else
+    settings_window_present_panel(self, panel);
+}
+
+GtkWidget *settings_window_get_panel(SettingsWindow *self, const char *id)
+{
+  const SettingsPanel *panel = settings_panels_lookup(id);
+
+  g_return_val_if_fail(panel != NULL, NULL);
+
+  return settings_window_ensure_panel(self, panel);
+}
+
+static void
+on_sidebar_selected(GtkSingleSelection *selection, GParamSpec *pspec, SettingsWindow *self)
+{
+  SettingsPanelItem *item = gtk_single_selection_get_selected_item(selection);
+
+  if (item)
+    settings_window_present_panel(self, settings_panel_item_get_panel(item));
+}
+
+static void
+on_show_content_changed(AdwNavigationSplitView *split_view, GParamSpec *pspec, SettingsWindow *self)
+{
+  /* When collapsed, going back to the sidebar drops the selection so that
+   * picking the same panel again navigates to it. */
+  if (adw_navigation_split_view_get_collapsed(split_view) && !adw_navigation_split_view_get_show_content(split_view))
+    gtk_single_selection_set_selected(self->sidebar_selection, GTK_INVALID_LIST_POSITION);
+}
+
+static void
+on_collapsed_changed(AdwNavigationSplitView *split_view, GParamSpec *pspec, SettingsWindow *self)
+{
+  const SettingsPanel *panel;
+  const char *visible_child_name;
+
+  if (adw_navigation_split_view_get_collapsed(split_view))
+    return;
+
+  visible_child_name = gtk_stack_get_visible_child_name(self->main_stack);
+  panel = visible_child_name ? settings_panels_lookup(visible_child_name) : NULL;
+
+  if (panel)
+    gtk_single_selection_set_selected(self->sidebar_selection, settings_panels_get_position(panel));
 }
 
-typedef struct
+static void
+sidebar_item_setup(GtkSignalListItemFactory *factory, GtkListItem *list_item, gpointer user_data)
 {
-  char *name;
-  SettingsWindow *self;
-  GtkButton *item;
-} StackItemSwitchHelperArgs;
+  GtkBox *box = GTK_BOX(gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4));
+  gtk_widget_set_name(GTK_WIDGET(box), "settings_stack_item");
+  gtk_box_append(box, gtk_image_new());
+  gtk_box_append(box, gtk_label_new(NULL));
 
-gboolean stack_item_switch_helper(GtkWidget *item,
-                                  StackItemSwitchHelperArgs *args)
+  gtk_list_item_set_child(list_item, GTK_WIDGET(box));
+}
+
+static void
+sidebar_item_bind(GtkSignalListItemFactory *factory, GtkListItem *list_item, gpointer user_data)
 {
-  gtk_stack_set_visible_child_name(args->self->main_stack, args->name);
+  GtkWidget *box = gtk_list_item_get_child(list_item);
+  const SettingsPanel *panel = settings_panel_item_get_panel(gtk_list_item_get_item(list_item));
 
-  adw_navigation_split_view_set_show_content(args->self->split_view, TRUE);
+  GtkWidget *image = gtk_widget_get_first_child(box);
+  GtkWidget *label = gtk_widget_get_next_sibling(image);
 
-  // adw_header_bar_set_title (args->self->secondary_header_bar, args->name);
+  gtk_image_set_from_icon_name(GTK_IMAGE(image), panel->icon_name);
+  gtk_label_set_label(GTK_LABEL(label), panel->title);
 
-  return TRUE;
+  if (panel->group_start)
+    gtk_widget_add_css_class(box, "settings-group-start");
+  else
+    gtk_widget_remove_css_class(box, "settings-group-start");
 }
 
-void stack_item_highlight_helper(GtkWidget *thingy,
-                                 GtkWidget *widget,
-                                 StackItemSwitchHelperArgs *args)
+static void
+on_search_changed(GtkSearchEntry *entry, SettingsWindow *self)
 {
-  const char *visible_child_name = gtk_stack_get_visible_child_name(args->self->main_stack);
+  const char *text = gtk_editable_get_text(GTK_EDITABLE(entry));
+  guint n_items = g_list_model_get_n_items(G_LIST_MODEL(self->search_results));
 
-  if (!args->name || !visible_child_name)
+  if (!text || !*text)
   {
+    g_list_store_remove_all(self->search_results);
+    gtk_stack_set_visible_child_name(self->sidebar_stack, "panels");
     return;
   }
 
-  if (!strcmp(visible_child_name, args->name))
+  GPtrArray *results = settings_search_query(text, MAX_SEARCH_RESULTS);
+
+  /* Swap all results in one go so the view only updates once */
+  g_list_store_splice(self->search_results, 0, n_items, results->pdata, results->len);
+  gtk_stack_set_visible_child_name(self->sidebar_stack, results->len ? "results" : "empty");
+
+  g_ptr_array_unref(results);
+}
+
+static void
+on_stop_search(GtkSearchEntry *entry, SettingsWindow *self)
+{
+  gtk_editable_set_text(GTK_EDITABLE(entry), "");
+}
+
+static gboolean
+focus_search_row(GtkWidget *row)
+{
+  /* Focusing the row also scrolls its preferences page to it */
+  gtk_widget_grab_focus(row);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+on_search_result_activated(GtkListView *list, guint position, SettingsWindow *self)
+{
+  SettingsSearchResult *result = g_list_model_get_item(G_LIST_MODEL(self->search_results), position);
+
+  if (!result)
+    return;
+
+  settings_window_show_panel(self, settings_search_result_get_panel_id(result));
+
+  /* Only the selected panel is walked, and only once per activation */
+  GtkWidget *page = gtk_stack_get_child_by_name(self->main_stack, settings_search_result_get_panel_id(result));
+  GtkWidget *row = page ? find_row(page, settings_search_result_get_row_id(result), settings_search_result_get_title(result)) : NULL;
+
+  /* The page may have just been built, so wait for it to be mapped */
+  if (row)
+    g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, (GSourceFunc)focus_search_row, g_object_ref(row), g_object_unref);
+
+  g_object_unref(result);
+}
+
+static void
+search_result_setup(GtkSignalListItemFactory *factory, GtkListItem *list_item, gpointer user_data)
+{
+  GtkBox *box = GTK_BOX(gtk_box_new(GTK_ORIENTATION_VERTICAL, 2));
+  GtkWidget *title = gtk_label_new(NULL);
+  GtkWidget *panel = gtk_label_new(NULL);
+
+  gtk_label_set_xalign(GTK_LABEL(title), 0);
+  gtk_label_set_xalign(GTK_LABEL(panel), 0);
+  gtk_widget_add_css_class(panel, "dim-label");
+  gtk_widget_add_css_class(panel, "caption");
+
+  gtk_box_append(box, title);
+  gtk_box_append(box, panel);
+
+  gtk_list_item_set_child(list_item, GTK_WIDGET(box));
+}
+
+static void
+search_result_bind(GtkSignalListItemFactory *factory, GtkListItem *list_item, gpointer user_data)
+{
+  SettingsSearchResult *result = gtk_list_item_get_item(list_item);
+  const SettingsPanel *panel = settings_panels_lookup(settings_search_result_get_panel_id(result));
+
+  GtkWidget *title = gtk_widget_get_first_child(gtk_list_item_get_child(list_item));
+  GtkWidget *panel_label = gtk_widget_get_next_sibling(title);
+
+  gtk_label_set_label(GTK_LABEL(title), settings_search_result_get_title(result));
+  gtk_label_set_label(GTK_LABEL(panel_label), panel ? panel->title : settings_search_result_get_panel_id(result));
+}
+
+static gboolean
+prewarm_next_panel(SettingsWindow *self)
+{
+  guint n_panels;
+  const SettingsPanel *panels = settings_panels_get(&n_panels);
+
+  if (self->prewarm_next >= n_panels)
   {
-    gtk_widget_set_state_flags(GTK_WIDGET(args->item), GTK_STATE_FLAG_SELECTED, TRUE);
+    self->prewarm_source = 0;
+    settings_profiler_end("prewarm");
+    return G_SOURCE_REMOVE;
   }
-  else
+
+  /* One panel per iteration so input and redraws can run in between */
+  settings_window_ensure_panel(self, &panels[self->prewarm_next++]);
+
+  return G_SOURCE_CONTINUE;
+}
+
+void settings_window_prewarm(SettingsWindow *self)
+{
+  if (self->prewarm_source == 0 && g_settings_get_boolean(self->settings, "prewarm-panels"))
   {
-    gtk_widget_set_state_flags(GTK_WIDGET(args->item), GTK_STATE_FLAG_NORMAL, TRUE);
+    settings_profiler_begin("prewarm");
+    self->prewarm_source = g_idle_add_full(G_PRIORITY_LOW, (GSourceFunc)prewarm_next_panel, self, NULL);
   }
 }
 
-GtkWidget *create_stack_item(SettingsWindow *self,
-                             char *name,
-                             char *display_name,
-                             char *icon_name)
+static void
+on_first_frame(GdkFrameClock *frame_clock, SettingsWindow *self)
 {
-  GtkButton *item = GTK_BUTTON(gtk_button_new());
-  GtkBox *box = GTK_BOX(gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4));
-  gtk_widget_set_name(GTK_WIDGET(item), "settings_stack_item");
-  gtk_box_append(box, gtk_image_new_from_icon_name(icon_name));
-  gtk_box_append(box, gtk_label_new(display_name));
-  gtk_button_set_child(item, GTK_WIDGET(box));
+  g_signal_handlers_disconnect_by_func(frame_clock, on_first_frame, self);
 
-  StackItemSwitchHelperArgs *args = malloc(sizeof(StackItemSwitchHelperArgs));
-  args->name = name;
-  args->self = self;
-  args->item = item;
+  settings_window_prewarm(self);
 
-  g_signal_connect(item, "clicked", (GCallback)stack_item_switch_helper, args);
-  g_signal_connect(self->main_stack, "notify::visible-child", (GCallback)stack_item_highlight_helper, args);
+  settings_profiler_first_frame();
+}
 
-  return GTK_WIDGET(item);
+static void
+on_before_paint(GdkFrameClock *frame_clock, SettingsWindow *self)
+{
+  self->frame_start = g_get_monotonic_time();
 }
 
-GtkWidget *create_stack_spacer()
+/* A frame that took longer than the refresh interval to lay out and
+ * paint missed its vblank, and counts as dropped */
+static void
+on_after_paint(GdkFrameClock *frame_clock, SettingsWindow *self)
 {
-  GtkWidget *widget = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
-  gtk_widget_set_size_request(widget, 0, 0);
-  gtk_widget_set_name(widget, "settings_stack_spacer");
-  return widget;
+  gint64 refresh_interval, presentation_time;
+
+  if (!self->frame_start)
+    return;
+
+  gdk_frame_clock_get_refresh_info(frame_clock, gdk_frame_clock_get_frame_time(frame_clock), &refresh_interval, &presentation_time);
+
+  settings_profiler_sample("frame", self->frame_start);
+  if (g_get_monotonic_time() - self->frame_start > refresh_interval)
+    settings_profiler_sample("frame:dropped", self->frame_start);
+
+  self->frame_start = 0;
 }
 
 static void
-settings_window_init(SettingsWindow *self)
+settings_window_map(GtkWidget *widget)
 {
-  adw_init();
+  SettingsWindow *self = SETTINGS_WINDOW(widget);
+  GdkFrameClock *frame_clock;
 
-  gtk_widget_init_template(GTK_WIDGET(self));
+  GTK_WIDGET_CLASS(settings_window_parent_class)->map(widget);
 
-  GtkCssProvider *cssProvider = gtk_css_provider_new();
-  gtk_css_provider_load_from_resource(cssProvider, "/com/plenjos/Settings/theme.css");
-  gtk_style_context_add_provider_for_display(gdk_display_get_default(),
-                                             GTK_STYLE_PROVIDER(cssProvider),
-                                             GTK_STYLE_PROVIDER_PRIORITY_USER);
+  frame_clock = gtk_widget_get_frame_clock(widget);
+
+  if (self->prewarm_next == 0)
+    g_signal_connect_object(frame_clock, "after-paint", G_CALLBACK(on_first_frame), self, 0);
+
+  if (settings_profiler_is_sampling() && !self->sampling_frames)
+  {
+    self->sampling_frames = TRUE;
+    g_signal_connect_object(frame_clock, "before-paint", G_CALLBACK(on_before_paint), self, 0);
+    g_signal_connect_object(frame_clock, "after-paint", G_CALLBACK(on_after_paint), self, 0);
+  }
+}
+
+static void
+settings_window_dispose(GObject *object)
+{
+  SettingsWindow *self = SETTINGS_WINDOW(object);
+
+  if (self->prewarm_source)
+  {
+    g_clear_handle_id(&self->prewarm_source, g_source_remove);
+    settings_profiler_end("prewarm");
+  }
+  g_clear_handle_id(&self->eviction_source, g_source_remove);
+
+  if (self->panel_states)
+  {
+    guint n_panels;
+    settings_panels_get(&n_panels);
 
-  NetworkSettingsWindow *network_settings = g_object_new(NETWORK_SETTINGS_TYPE_WINDOW, NULL);
-  DisplaySettingsWindow *display_settings = g_object_new(DISPLAY_SETTINGS_TYPE_WINDOW, NULL);
-  AppearanceSettingsWindow *appearance_settings = g_object_new(APPEARANCE_SETTINGS_TYPE_WINDOW, NULL);
-  PanelSettingsWindow *panel_settings = g_object_new(PANEL_SETTINGS_TYPE_WINDOW, NULL);
+    for (guint i = 0; i < n_panels; i++)
+      panel_state_clear(&self->panel_states[i]);
 
-  gtk_stack_add_titled(self->main_stack, GTK_WIDGET(network_settings), "Network", "Network");
-  gtk_box_append(self->sidebar_box, create_stack_item(self, "Network", "Network", "preferences-system-network"));
+    g_clear_pointer(&self->panel_states, g_free);
+  }
 
-  GtkWidget *bluetooth_settings = bluetooth_settings_widget_new();
+  g_clear_object(&self->settings);
+  g_clear_object(&self->search_results);
 
-  GtkBox *bluetooth_settings_box = GTK_BOX(gtk_box_new(GTK_ORIENTATION_VERTICAL, 0));
+  G_OBJECT_CLASS(settings_window_parent_class)->dispose(object);
+}
 
-  gtk_box_append(bluetooth_settings_box, adw_header_bar_new());
-  gtk_box_append(bluetooth_settings_box, bluetooth_settings);
+static void
+settings_window_class_init(SettingsWindowClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
 
-  AdwNavigationPage *bluetooth_page = adw_navigation_page_new(GTK_WIDGET(bluetooth_settings_box), "Bluetooth");
+  object_class->dispose = settings_window_dispose;
+  widget_class->map = settings_window_map;
 
-  gtk_stack_add_titled(self->main_stack, GTK_WIDGET(bluetooth_page), "Bluetooth", "Bluetooth");
-  gtk_box_append(self->sidebar_box, create_stack_item(self, "Bluetooth", "Bluetooth", "bluetooth-active"));
+  gtk_widget_class_set_template_from_resource(widget_class, "/com/plenjos/Settings/settings-window.ui");
+  gtk_widget_class_bind_template_child(widget_class, SettingsWindow, sidebar_box);
+  gtk_widget_class_bind_template_child(widget_class, SettingsWindow, sidebar_list);
+  gtk_widget_class_bind_template_child(widget_class, SettingsWindow, search_entry);
+  gtk_widget_class_bind_template_child(widget_class, SettingsWindow, sidebar_stack);
+  gtk_widget_class_bind_template_child(widget_class, SettingsWindow, search_results_list);
+  gtk_widget_class_bind_template_child(widget_class, SettingsWindow, main_stack);
+  gtk_widget_class_bind_template_child(widget_class, SettingsWindow, split_view);
+}
 
-  gtk_box_append(self->sidebar_box, create_stack_spacer());
+void stack_switcher_set_halign_helper(GtkWidget *widget,
+                                      gpointer data)
+{
+  gtk_widget_set_halign(widget, GTK_ALIGN_START);
+}
 
-  gtk_stack_add_titled(self->main_stack, GTK_WIDGET(display_settings), "Displays", "Displays");
-  gtk_box_append(self->sidebar_box, create_stack_item(self, "Displays", "Displays", "preferences-desktop-display"));
+void stack_switcher_set_halign(GtkWidget *widget,
+                               gpointer data)
+{
+  // gtk_container_foreach (widget, stack_switcher_set_halign_helper, NULL);
+}
+
+static void
+settings_window_init(SettingsWindow *self)
+{
+  adw_init();
 
-  gtk_stack_add_titled(self->main_stack, GTK_WIDGET(appearance_settings), "Appearance", "Appearance");
-  gtk_box_append(self->sidebar_box, create_stack_item(self, "Appearance", "Appearance", "preferences-desktop-theme"));
+  settings_profiler_begin("SettingsWindow:init_template");
+  gtk_widget_init_template(GTK_WIDGET(self));
+  settings_profiler_end("SettingsWindow:init_template");
 
-  gtk_stack_add_titled(self->main_stack, GTK_WIDGET(panel_settings), "Panel", "Panel");
-  gtk_box_append(self->sidebar_box, create_stack_item(self, "Panel", "Panel", "panel"));
+  settings_profiler_begin("css");
+  GtkCssProvider *cssProvider = gtk_css_provider_new();
+  gtk_css_provider_load_from_resource(cssProvider, "/com/plenjos/Settings/theme.css");
+  gtk_style_context_add_provider_for_display(gdk_display_get_default(),
+                                             GTK_STYLE_PROVIDER(cssProvider),
+                                             GTK_STYLE_PROVIDER_PRIORITY_USER);
+  settings_profiler_end("css");
+
+  self->settings = g_settings_new("com.plenjos.Settings");
+
+  guint n_panels;
+  settings_panels_get(&n_panels);
+  self->panel_states = g_new0(PanelState, n_panels);
+
+  g_signal_connect(self->main_stack, "notify::visible-child", G_CALLBACK(on_visible_child_changed), self);
+  g_signal_connect(self, "notify::focus-widget", G_CALLBACK(on_focus_widget_changed), NULL);
+  g_signal_connect_swapped(self->settings, "changed::page-eviction-timeout", G_CALLBACK(schedule_eviction), self);
+
+  /* Only the sidebar is built here; pages are created when selected */
+  GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+  g_signal_connect(factory, "setup", G_CALLBACK(sidebar_item_setup), NULL);
+  g_signal_connect(factory, "bind", G_CALLBACK(sidebar_item_bind), NULL);
+
+  self->sidebar_selection = gtk_single_selection_new(settings_panels_create_model());
+  gtk_single_selection_set_autoselect(self->sidebar_selection, FALSE);
+  gtk_single_selection_set_can_unselect(self->sidebar_selection, TRUE);
+  gtk_single_selection_set_selected(self->sidebar_selection, GTK_INVALID_LIST_POSITION);
+
+  /* The list view takes ownership of both */
+  gtk_list_view_set_factory(self->sidebar_list, factory);
+  gtk_list_view_set_model(self->sidebar_list, GTK_SELECTION_MODEL(self->sidebar_selection));
+  g_object_unref(factory);
+  g_object_unref(self->sidebar_selection);
+
+  g_signal_connect(self->sidebar_selection, "notify::selected", G_CALLBACK(on_sidebar_selected), self);
+  g_signal_connect(self->split_view, "notify::show-content", G_CALLBACK(on_show_content_changed), self);
+  g_signal_connect(self->split_view, "notify::collapsed", G_CALLBACK(on_collapsed_changed), self);
+
+  /* Search results come from the prebuilt index, never from the pages */
+  GtkListItemFactory *results_factory = gtk_signal_list_item_factory_new();
+  g_signal_connect(results_factory, "setup", G_CALLBACK(search_result_setup), NULL);
+  g_signal_connect(results_factory, "bind", G_CALLBACK(search_result_bind), NULL);
+
+  self->search_results = g_list_store_new(SETTINGS_TYPE_SEARCH_RESULT);
+  GtkNoSelection *results_selection = gtk_no_selection_new(G_LIST_MODEL(g_object_ref(self->search_results)));
+
+  gtk_list_view_set_factory(self->search_results_list, results_factory);
+  gtk_list_view_set_model(self->search_results_list, GTK_SELECTION_MODEL(results_selection));
+  g_object_unref(results_factory);
+  g_object_unref(results_selection);
+
+  g_signal_connect(self->search_results_list, "activate", G_CALLBACK(on_search_result_activated), self);
+  g_signal_connect(self->search_entry, "search-changed", G_CALLBACK(on_search_changed), self);
+  g_signal_connect(self->search_entry, "stop-search", G_CALLBACK(on_stop_search), self);
+  gtk_search_entry_set_key_capture_widget(self->search_entry, GTK_WIDGET(self));
 }
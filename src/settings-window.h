@@ -22,12 +22,7 @@
 
 #include <libadwaita-1/adwaita.h>
 
-#include "network/network-settings-window.h"
-#include "display/display-settings-window.h"
-#include "appearance/appearance-settings-window.h"
-#include "panel/panel-settings-window.h"
-
-#include <gnome-bluetooth-3.0/bluetooth-settings-widget.h>
+#include "settings-panel.h"
 
 G_BEGIN_DECLS
 
@@ -35,6 +30,11 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (SettingsWindow, settings_window, SETTINGS, WINDOW, AdwApplicationWindow)
 
+void settings_window_show_panel(SettingsWindow *self, const char *id);
+/* Returns the panel's page, building it if it has to */
+GtkWidget *settings_window_get_panel(SettingsWindow *self, const char *id);
+void settings_window_prewarm(SettingsWindow *self);
+
 G_END_DECLS
 
 #define G_VALUE_INIT  { 0, { { 0 } } }
@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+#
+# mock_nm.py
+#
+# Copyright 2023 Benjamin Montgomery
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+"""A stand-in NetworkManager on private buses, for the benchmark and the
+soak test.
+
+This is python-dbusmock's networkmanager template with helpers for the
+scenarios they script: batches of access points, bursts of strength
+changes, devices coming and going and saved connections. plenjos-settings
+is started against it with a private session bus as well, so it can't
+hand the command line to an instance that is already running.
+
+Exits with 77 (skipped) where it can't run: no dbusmock or no display.
+"""
+
+import json
+import os
+import shutil
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+
+SKIP = 77
+
+try:
+    import dbus
+    import dbusmock
+except ImportError:
+    print("python-dbusmock is not installed")
+    sys.exit(SKIP)
+
+NM_BUS = "org.freedesktop.NetworkManager"
+MANAGER_IFACE = "org.freedesktop.NetworkManager"
+ACCESS_POINT_IFACE = "org.freedesktop.NetworkManager.AccessPoint"
+
+DEVICE_STATE_DISCONNECTED = 30
+MODE_INFRA = 2
+SECURITY_NONE = 0x0
+SECURITY_KEY_MGMT_PSK = 0x100
+
+APP_ID = "com.plenjos.Settings"
+APP_PATH = "/com/plenjos/Settings"
+
+
+def require_display():
+    if not os.environ.get("WAYLAND_DISPLAY") and not os.environ.get("DISPLAY"):
+        print("No display to open the settings window on")
+        sys.exit(SKIP)
+
+
+class MockNetworkManager:
+    """One run of the template. Access points and devices are named from
+    counters so every object path is new, as with a real NM."""
+
+    def __init__(self):
+        self.process, self.manager = dbusmock.DBusTestCase.spawn_server_template(
+            "networkmanager", {}, stdout=subprocess.DEVNULL)
+        self.bus = dbusmock.DBusTestCase.get_dbus(system_bus=True)
+        self.next_ap = 0
+
+    def close(self):
+        self.process.terminate()
+        self.process.wait()
+
+    def _mock(self, path=None):
+        obj = self.manager if path is None else self.bus.get_object(NM_BUS, path)
+        return dbus.Interface(obj, dbusmock.MOCK_IFACE)
+
+    def add_wifi_device(self, iface):
+        return self._mock().AddWiFiDevice("mock_" + iface, iface, DEVICE_STATE_DISCONNECTED)
+
+    def add_ethernet_device(self, iface):
+        return self._mock().AddEthernetDevice("mock_" + iface, iface, DEVICE_STATE_DISCONNECTED)
+
+    def remove_device(self, device):
+        """The template has no call for this, so do what NM does: drop the
+        object, take it out of Devices and say so."""
+        mock = self._mock()
+        props = dbus.Interface(self.manager, dbus.PROPERTIES_IFACE)
+
+        mock.RemoveObject(device)
+
+        updated = {}
+        for name in ("Devices", "AllDevices"):
+            try:
+                paths = props.Get(MANAGER_IFACE, name)
+            except dbus.exceptions.DBusException:
+                continue
+            updated[name] = dbus.Array([p for p in paths if p != device], signature="o")
+
+        mock.UpdateProperties(MANAGER_IFACE, updated)
+        mock.EmitSignal(MANAGER_IFACE, "DeviceRemoved", "o", [dbus.ObjectPath(device)])
+
+    def add_access_point(self, device, ssid, strength=50, frequency=2412, secured=False):
+        self.next_ap += 1
+        n = self.next_ap
+        bssid = "02:00:%02X:%02X:%02X:%02X" % ((n >> 24) & 0xff, (n >> 16) & 0xff, (n >> 8) & 0xff, n & 0xff)
+        security = SECURITY_KEY_MGMT_PSK if secured else SECURITY_NONE
+
+        return self._mock().AddAccessPoint(device, "ap%d" % n, ssid, bssid, MODE_INFRA,
+                                           dbus.UInt32(frequency), dbus.UInt32(54000),
+                                           dbus.Byte(strength), dbus.UInt32(security))
+
+    def remove_access_point(self, device, ap):
+        self._mock().RemoveAccessPoint(device, ap)
+
+    def set_strength(self, ap, strength):
+        self._mock(ap).UpdateProperties(ACCESS_POINT_IFACE, {"Strength": dbus.Byte(strength)})
+
+    def add_connection(self, device, name, ssid):
+        return self._mock().AddWiFiConnection(device, name, ssid, "wpa-psk")
+
+    def remove_connection(self, device, connection):
+        self._mock().RemoveWifiConnection(device, connection)
+
+
+class Settings:
+    """plenjos-settings with one device's page open, profiling into a
+    temporary directory that also stands in for the user's cache, config
+    and state, so the scan cache and connection timing of the real user
+    are left alone."""
+
+    def __init__(self, app, open_device, extra_env=None):
+        self.dir = tempfile.mkdtemp(prefix="plenjos-settings-test-")
+        self.profile = os.path.join(self.dir, "profile.json")
+
+        env = dict(os.environ)
+        env.update({
+            "XDG_CACHE_HOME": os.path.join(self.dir, "cache"),
+            "XDG_CONFIG_HOME": os.path.join(self.dir, "config"),
+            "XDG_STATE_HOME": os.path.join(self.dir, "state"),
+            "GSETTINGS_BACKEND": "memory",
+        })
+        env.update(extra_env or {})
+
+        self.process = subprocess.Popen([app, "--device=" + open_device, "--profile-startup=" + self.profile],
+                                        env=env, stderr=subprocess.PIPE, text=True)
+        self.stderr = ""
+
+    def open_device(self, iface):
+        """Opens the device's page again, as after it was unplugged, through
+        the app.open-device action on our private session bus"""
+        app = dbusmock.DBusTestCase.get_dbus(system_bus=False).get_object(APP_ID, APP_PATH)
+        app.Activate("open-device", [dbus.String(iface, variant_level=1)], {},
+                     dbus_interface="org.gtk.Actions")
+
+    def alive(self):
+        return self.process.poll() is None
+
+    def stop(self, timeout=60):
+        """Asks the app to quit, which writes the samples, and returns its
+        exit status"""
+        if self.alive():
+            self.process.send_signal(signal.SIGTERM)
+        try:
+            _, self.stderr = self.process.communicate(timeout=timeout)
+        except subprocess.TimeoutExpired:
+            self.process.kill()
+            _, self.stderr = self.process.communicate()
+        return self.process.returncode
+
+    def samples(self):
+        """Returns (samples by name, peak RSS in KiB)"""
+        with open(self.profile + ".samples.json", encoding="utf-8") as f:
+            report = json.load(f)
+        return {s["name"]: s for s in report["samples"]}, report.get("peak_rss_kb")
+
+    def cleanup(self):
+        shutil.rmtree(self.dir, ignore_errors=True)
+
+
+def start_buses():
+    """Private system and session buses, set in os.environ for the
+    processes started from here on"""
+    dbusmock.DBusTestCase.start_system_bus()
+    dbusmock.DBusTestCase.start_session_bus()
+
+
+def stop_buses():
+    dbusmock.DBusTestCase.tearDownClass()
+
+
+def settle(seconds):
+    """Gives the app time to hear about what was just changed"""
+    time.sleep(seconds)
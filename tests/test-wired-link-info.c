@@ -0,0 +1,189 @@
+/* test-wired-link-info.c
+ *
+ * Copyright 2023 Benjamin Montgomery
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Reads the link details of lo, which every system has, and of an
+ * interface given in WIRED_LINK_INFO_TEST_IFACE, e.g. a dummy or veth
+ * created for the purpose, since creating one here needs CAP_NET_ADMIN.
+ */
+
+#include "settings-config.h"
+#include "wired-link-info.h"
+
+typedef struct ReadResult
+{
+  gboolean done;
+  WiredLinkInfo *info;
+  GError *error;
+} ReadResult;
+
+static void
+on_read(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+  ReadResult *read = user_data;
+
+  read->info = wired_link_info_read_finish(result, &read->error);
+  read->done = TRUE;
+}
+
+static WiredLinkInfo *
+read_info(const char *iface, GError **error)
+{
+  ReadResult read = {0};
+
+  wired_link_info_read_async(iface, NULL, on_read, &read);
+  while (!read.done)
+    g_main_context_iteration(NULL, TRUE);
+
+  if (read.error)
+    g_propagate_error(error, read.error);
+
+  return read.info;
+}
+
+static int
+read_sysfs_mtu(const char *iface)
+{
+  char *path = g_build_filename("/sys/class/net", iface, "mtu", NULL);
+  char *contents = NULL;
+  int mtu = -1;
+
+  if (g_file_get_contents(path, &contents, NULL, NULL))
+    mtu = (int)g_ascii_strtoll(contents, NULL, 10);
+
+  g_free(contents);
+  g_free(path);
+
+  return mtu;
+}
+
+static void
+assert_consistent(const WiredLinkInfo *info)
+{
+  const int flags[] = {info->tso, info->gso, info->gro, info->rx_checksum, info->tx_checksum};
+
+  for (guint i = 0; i < G_N_ELEMENTS(flags); i++)
+  {
+    g_assert_cmpint(flags[i], >=, -1);
+    g_assert_cmpint(flags[i], <=, 1);
+  }
+
+  /* A ring is reported with its maximum or not at all */
+  g_assert_cmpint(info->rx_ring < 0, ==, info->rx_ring_max < 0);
+  g_assert_cmpint(info->tx_ring < 0, ==, info->tx_ring_max < 0);
+
+  if (info->max_mtu > 0)
+    g_assert_cmpint(info->mtu, <=, info->max_mtu);
+  if (info->min_mtu > 0)
+    g_assert_cmpint(info->mtu, >=, info->min_mtu);
+}
+
+static void
+test_loopback(void)
+{
+  GError *error = NULL;
+  WiredLinkInfo *info = read_info("lo", &error);
+
+  g_assert_no_error(error);
+  g_assert_nonnull(info);
+
+  g_assert_cmpint(info->mtu, ==, read_sysfs_mtu("lo"));
+  assert_consistent(info);
+
+  /* lo has no link settings and no rings */
+  g_assert_cmpint(info->speed, ==, -1);
+  g_assert_cmpint(info->full_duplex, ==, -1);
+  g_assert_cmpint(info->rx_ring, ==, -1);
+  g_assert_cmpint(info->rx_ring_max, ==, -1);
+  g_assert_cmpint(info->tx_ring, ==, -1);
+  g_assert_cmpint(info->tx_ring_max, ==, -1);
+
+  g_free(info);
+}
+
+static void
+test_missing(void)
+{
+  GError *error = NULL;
+  WiredLinkInfo *info = read_info("plenjos-none0", &error);
+
+  /* Nothing is reported, rather than an error */
+  g_assert_no_error(error);
+  g_assert_nonnull(info);
+
+  g_assert_cmpint(info->mtu, ==, -1);
+  g_assert_cmpint(info->min_mtu, ==, -1);
+  g_assert_cmpint(info->max_mtu, ==, -1);
+  g_assert_cmpint(info->speed, ==, -1);
+  g_assert_cmpint(info->tso, ==, -1);
+  g_assert_cmpint(info->rx_ring, ==, -1);
+
+  g_free(info);
+}
+
+static void
+test_invalid_name(void)
+{
+  GError *error = NULL;
+  WiredLinkInfo *info = read_info("an-interface-name-too-long", &error);
+
+  g_assert_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+  g_assert_null(info);
+
+  g_error_free(error);
+}
+
+static void
+test_given_interface(void)
+{
+  const char *iface = g_getenv("WIRED_LINK_INFO_TEST_IFACE");
+  GError *error = NULL;
+  WiredLinkInfo *info;
+
+  if (!iface || !*iface)
+  {
+    g_test_skip("WIRED_LINK_INFO_TEST_IFACE is not set");
+    return;
+  }
+
+  info = read_info(iface, &error);
+
+  g_assert_no_error(error);
+  g_assert_nonnull(info);
+
+  g_assert_cmpint(info->mtu, ==, read_sysfs_mtu(iface));
+  assert_consistent(info);
+
+  /* Neither dummy nor veth has rings */
+  g_assert_cmpint(info->rx_ring, ==, -1);
+  g_assert_cmpint(info->tx_ring, ==, -1);
+
+  g_free(info);
+}
+
+int main(int argc,
+         char *argv[])
+{
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/wired-link-info/loopback", test_loopback);
+  g_test_add_func("/wired-link-info/missing", test_missing);
+  g_test_add_func("/wired-link-info/invalid-name", test_invalid_name);
+  g_test_add_func("/wired-link-info/given-interface", test_given_interface);
+
+  return g_test_run();
+}
@@ -0,0 +1,226 @@
+#!/usr/bin/env python3
+#
+# wifi-benchmark.py
+#
+# Copyright 2023 Benjamin Montgomery
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+"""Times the Wi-Fi list against a stand-in NetworkManager.
+
+Each scenario starts a fresh mock and a fresh plenjos-settings with the
+Wi-Fi page open, scripts changes through the mock, then stops the app and
+reads the samples it wrote (see settings-profiler.h):
+
+    time-to-populate  process start to the list first filled
+    populate          filling the list, once the page is built
+    ap-latency        first queued AP change to its batch in the list
+    ap-batch          applying one batch
+    frames, dropped   frames painted, and those over the refresh interval
+    peak RSS
+
+Run with `meson test --benchmark`, or directly with the path to the
+plenjos-settings binary.
+"""
+
+import argparse
+import json
+import random
+import sys
+
+import mock_nm
+
+WIFI_IFACE = "wlan0"
+
+
+def populate(nm, run):
+    """1000 BSSIDs over 600 SSIDs, there before the page opens"""
+    device = nm.add_wifi_device(WIFI_IFACE)
+    for i in range(1000):
+        nm.add_access_point(device, "net-%d" % (i % 600), strength=random.randint(5, 100),
+                            frequency=random.choice((2412, 2437, 2462, 5180, 5500)), secured=i % 3 != 0)
+
+    app = run()
+    mock_nm.settle(5)
+    return app
+
+
+def strength_bursts(nm, run):
+    """300 BSSIDs whose strengths all change 20 times over 4 s"""
+    device = nm.add_wifi_device(WIFI_IFACE)
+    aps = [nm.add_access_point(device, "net-%d" % i, strength=50) for i in range(300)]
+
+    app = run()
+    mock_nm.settle(3)
+
+    for _ in range(20):
+        for ap in aps:
+            nm.set_strength(ap, random.randint(5, 100))
+        mock_nm.settle(0.2)
+
+    mock_nm.settle(2)
+    return app
+
+
+def hotplug(nm, run):
+    """Devices coming and going while a scan keeps replacing APs"""
+    device = nm.add_wifi_device(WIFI_IFACE)
+    aps = [nm.add_access_point(device, "net-%d" % i) for i in range(200)]
+
+    app = run()
+    mock_nm.settle(3)
+
+    for cycle in range(10):
+        wifi = nm.add_wifi_device("wlan%d" % (cycle + 1))
+        ethernet = nm.add_ethernet_device("eth%d" % (cycle + 1))
+        for i in range(50):
+            nm.add_access_point(wifi, "other-%d" % i)
+
+        # A scan that drops a quarter of the list and finds as many new
+        for ap in aps[:50]:
+            nm.remove_access_point(device, ap)
+        aps = aps[50:] + [nm.add_access_point(device, "net-%d-%d" % (cycle, i)) for i in range(50)]
+
+        mock_nm.settle(0.5)
+        nm.remove_device(wifi)
+        nm.remove_device(ethernet)
+        mock_nm.settle(0.5)
+
+    mock_nm.settle(2)
+    return app
+
+
+def saved_connections(nm, run):
+    """500 saved profiles, a third of them in range, and 100 more saved
+    and forgotten while the page is open"""
+    device = nm.add_wifi_device(WIFI_IFACE)
+    for i in range(500):
+        nm.add_connection(device, "saved-%d" % i, "net-%d" % i)
+    for i in range(300):
+        nm.add_access_point(device, "net-%d" % (i * 3 // 2), secured=True)
+
+    app = run()
+    mock_nm.settle(3)
+
+    added = [nm.add_connection(device, "new-%d" % i, "net-%d" % i) for i in range(100)]
+    mock_nm.settle(1)
+    for connection in added:
+        nm.remove_connection(device, connection)
+
+    mock_nm.settle(2)
+    return app
+
+
+SCENARIOS = {
+    "populate-1000": populate,
+    "strength-bursts": strength_bursts,
+    "hotplug": hotplug,
+    "saved-connections": saved_connections,
+}
+
+
+def summarize(samples, peak_rss_kb):
+    def ms(name, key="mean"):
+        sample = samples.get(name)
+        if not sample or not sample["count"]:
+            return None
+        value = sample["total"] / sample["count"] if key == "mean" else sample[key]
+        return round(value / 1000, 2)
+
+    def count(name):
+        return samples[name]["count"] if name in samples else 0
+
+    return {
+        "time_to_populate_ms": ms("wifi:time-to-populate", "max"),
+        "populate_ms": ms("wifi:populate", "max"),
+        "ap_latency_ms": ms("wifi:ap-latency"),
+        "ap_latency_max_ms": ms("wifi:ap-latency", "max"),
+        "ap_batch_ms": ms("wifi:ap-batch"),
+        "ap_batch_max_ms": ms("wifi:ap-batch", "max"),
+        "ap_batches": count("wifi:ap-batch"),
+        "resorts": count("wifi:resort"),
+        "frames": count("frame"),
+        "frames_dropped": count("frame:dropped"),
+        "frame_max_ms": ms("frame", "max"),
+        "peak_rss_mb": round(peak_rss_kb / 1024, 1) if peak_rss_kb else None,
+    }
+
+
+def run_scenario(app_path, name):
+    nm = mock_nm.MockNetworkManager()
+    apps = []
+
+    def run():
+        apps.append(mock_nm.Settings(app_path, WIFI_IFACE))
+        return apps[-1]
+
+    try:
+        app = SCENARIOS[name](nm, run)
+
+        if not app.alive():
+            app.stop()
+            raise RuntimeError("plenjos-settings exited early:\n" + app.stderr)
+
+        status = app.stop()
+        if status != 0:
+            raise RuntimeError("plenjos-settings exited with %d:\n%s" % (status, app.stderr))
+
+        samples, peak_rss_kb = app.samples()
+        if "wifi:populate" not in samples:
+            raise RuntimeError("The Wi-Fi page was never populated:\n" + app.stderr)
+
+        return summarize(samples, peak_rss_kb)
+    finally:
+        for app in apps:
+            if app.alive():
+                app.stop()
+            app.cleanup()
+        nm.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("app", help="the plenjos-settings binary")
+    parser.add_argument("--scenario", action="append", choices=sorted(SCENARIOS))
+    parser.add_argument("--output", help="also write the results as JSON")
+    args = parser.parse_args()
+
+    mock_nm.require_display()
+    random.seed(0)
+
+    mock_nm.start_buses()
+    results = {}
+    try:
+        for name in args.scenario or SCENARIOS:
+            results[name] = run_scenario(args.app, name)
+    finally:
+        mock_nm.stop_buses()
+
+    for name, result in results.items():
+        print(name)
+        for key, value in result.items():
+            print("  %-20s %s" % (key, "-" if value is None else value))
+
+    if args.output:
+        with open(args.output, "w", encoding="utf-8") as f:
+            json.dump(results, f, indent=2)
+            f.write("\n")
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except RuntimeError as e:
+        sys.exit(str(e))
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+#
+# wifi-soak.py
+#
+# Copyright 2023 Benjamin Montgomery
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+"""Leak soak test for the Wi-Fi page.
+
+Replays thousands of batches of access points coming and going (through
+apply_ap_changes() and WifiNetwork), with strength changes to move them
+around the list, against a stand-in NetworkManager. Every so often the
+device is unplugged and plugged back in, which frees the whole page
+(destroy_interface_page()) and builds it again.
+
+Meant for a build with -Db_sanitize=address: LeakSanitizer then checks
+the process at exit, and any leak it reports fails the test, as does any
+AddressSanitizer error, such as a use after free. The few allocations the
+libraries keep on purpose are suppressed in lsan.supp, each with its
+reason. Without a sanitized build this skips.
+"""
+
+import argparse
+import os
+import random
+import re
+import sys
+
+import mock_nm
+
+WIFI_IFACE = "wlan0"
+
+# One block per leak, up to the blank line after its stack
+LEAK_RE = re.compile(r"^(Direct|Indirect) leak of (\d+) byte\(s\).*?(?=^\s*$)", re.M | re.S)
+
+
+def soak(nm, app, batches, batch_size, replug_every):
+    device = nm.add_wifi_device(WIFI_IFACE)
+    live = []
+
+    for batch in range(batches):
+        # Half of the SSIDs repeat, so BSSIDs merge into and leave networks
+        # as well as creating and dropping them
+        for i in range(batch_size):
+            ssid = "net-%d" % random.randrange(batch_size * 4) if i % 2 else "net-%d-%d" % (batch, i)
+            live.append(nm.add_access_point(device, ssid, strength=random.randint(5, 100)))
+
+        if len(live) > batch_size * 3:
+            for ap in live[:batch_size]:
+                nm.remove_access_point(device, ap)
+            del live[:batch_size]
+
+        for ap in random.sample(live, min(len(live), batch_size // 2)):
+            nm.set_strength(ap, random.randint(5, 100))
+
+        # Past AP_FLUSH_DELAY_MS, so every batch is applied on its own
+        mock_nm.settle(0.12)
+
+        if replug_every and batch % replug_every == replug_every - 1:
+            nm.remove_device(device)
+            mock_nm.settle(0.3)
+            device = nm.add_wifi_device(WIFI_IFACE)
+            app.open_device(WIFI_IFACE)
+            live = []
+            mock_nm.settle(0.3)
+
+    mock_nm.settle(1)
+
+
+def find_leaks(report):
+    """Returns (every leak LeakSanitizer reported, bytes leaked in all)"""
+    leaks = [match.group(0) for match in LEAK_RE.finditer(report)]
+    size = sum(int(match.group(2)) for match in LEAK_RE.finditer(report))
+
+    return leaks, size
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("app", help="the plenjos-settings binary")
+    parser.add_argument("--sanitized", action="store_true",
+                        help="the binary was built with -Db_sanitize=address")
+    parser.add_argument("--batches", type=int, default=2000)
+    parser.add_argument("--batch-size", type=int, default=20)
+    parser.add_argument("--replug-every", type=int, default=200)
+    args = parser.parse_args()
+
+    if not args.sanitized:
+        print("Not an AddressSanitizer build; configure with -Db_sanitize=address")
+        sys.exit(mock_nm.SKIP)
+
+    mock_nm.require_display()
+    random.seed(0)
+
+    suppressions = os.path.join(os.path.dirname(os.path.abspath(__file__)), "lsan.supp")
+    env = {
+        # Report, but leave the verdict to us
+        "ASAN_OPTIONS": "detect_leaks=1:abort_on_error=0:exitcode=66",
+        "LSAN_OPTIONS": "exitcode=0:print_suppressions=0:suppressions=" + suppressions,
+        # GLib's slice allocator and type caches hide leaks from LSan
+        "G_SLICE": "always-malloc",
+        "G_DEBUG": "gc-friendly",
+    }
+
+    mock_nm.start_buses()
+    nm = mock_nm.MockNetworkManager()
+    app = None
+    try:
+        app = mock_nm.Settings(args.app, WIFI_IFACE, env)
+        mock_nm.settle(3)
+
+        soak(nm, app, args.batches, args.batch_size, args.replug_every)
+
+        if not app.alive():
+            app.stop()
+            sys.exit("plenjos-settings exited during the soak:\n" + app.stderr)
+
+        status = app.stop(timeout=120)
+    finally:
+        if app:
+            if app.alive():
+                app.stop()
+            app.cleanup()
+        nm.close()
+        mock_nm.stop_buses()
+
+    if "ERROR: AddressSanitizer" in app.stderr or status != 0:
+        sys.exit("plenjos-settings failed (%d):\n%s" % (status, app.stderr))
+
+    leaks, size = find_leaks(app.stderr)
+
+    print("%d batches of %d access points, page rebuilt every %d" % (args.batches, args.batch_size, args.replug_every))
+
+    if leaks:
+        sys.exit("%d leaks, %d bytes in all:\n\n%s" % (len(leaks), size, "\n\n".join(leaks)))
+
+
+if __name__ == "__main__":
+    main()